@@ -3,6 +3,8 @@
 #ifndef COMMON_ERROR_HANDLING_H
 #define COMMON_ERROR_HANDLING_H
 
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -30,6 +32,11 @@ struct VulkanResultException{
 // just use cout for logging now
 std::ostream& logger = std::cout;
 
+// plain decimal digits only (no sign, spaces, or exponent); false if the text is not such a number or does not fit 64 bits
+bool parseCount( const char* text, uint64_t& count );
+// the count in the environment variable, or defaultValue if it is not set; an invalid value is logged and ignored
+uint64_t getEnvironmentCount( const char* name, uint64_t defaultValue );
+
 enum class Highlight{ off, on };
 void genericDebugCallback( std::string flags, Highlight highlight, std::string msgCode, std::string object, const char* message );
 
@@ -68,6 +75,34 @@ VkDebugReportFlagsEXT translateFlags( const VkDebugUtilsMessageSeverityFlagsEXT
 // Implementation
 //////////////////////////////////
 
+bool parseCount( const char* const text, uint64_t& count ){
+	if( !*text ) return false;
+
+	uint64_t value = 0;
+	for( const char* c = text; *c; ++c ){
+		if( *c < '0' || *c > '9' ) return false;
+		const uint64_t digit = static_cast<uint64_t>( *c - '0' );
+		if( value > (UINT64_MAX - digit) / 10 ) return false;
+		value = value * 10 + digit;
+	}
+
+	count = value;
+	return true;
+}
+
+uint64_t getEnvironmentCount( const char* const name, const uint64_t defaultValue ){
+	const char* const env = std::getenv( name );
+	if( !env ) return defaultValue;
+
+	uint64_t count;
+	if( !parseCount( env, count ) ){
+		logger << "WARNING: Ignoring invalid " << name << "=" << env << "; expected a count." << std::endl;
+		return defaultValue;
+	}
+
+	return count;
+}
+
 void genericDebugCallback( std::string flags, Highlight highlight, std::string msgCode, std::string object, const char* message ){
 	using std::endl;
 	using std::string;
@@ -32,6 +32,9 @@ void unloadDebugUtilsCommands( VkInstance instance );
 void loadExternalMemoryCapsCommands( VkInstance instance );
 void unloadExternalMemoryCapsCommands( VkInstance instance );
 
+void loadHeadlessSurfaceCommands( VkInstance instance );
+void unloadHeadlessSurfaceCommands( VkInstance instance );
+
 
 void loadExternalMemoryCommands( VkDevice device );
 void unloadExternalMemoryCommands( VkDevice device );
@@ -41,13 +44,23 @@ void loadExternalMemoryWin32Commands( VkDevice device );
 void unloadExternalMemoryWin32Commands( VkDevice device );
 #endif
 
+void loadGetMemoryRequirements2Commands( VkDevice device );
+void unloadGetMemoryRequirements2Commands( VkDevice device );
+
 void loadDedicatedAllocationCommands( VkDevice device );
 void unloadDedicatedAllocationCommands( VkDevice device );
 
+void loadTimelineSemaphoreCommands( VkDevice device );
+void unloadTimelineSemaphoreCommands( VkDevice device );
+
+void loadDrawIndirectCountCommands( VkDevice device );
+void unloadDrawIndirectCountCommands( VkDevice device );
+
 ////////////////////////////////////////////////////////
 
 std::unordered_map< VkInstance, std::vector<const char*> > instanceExtensionsMap;
 std::unordered_map< VkPhysicalDevice, VkInstance > physicalDeviceInstanceMap;
+std::unordered_map< VkCommandBuffer, VkDevice > commandBufferDeviceMap;
 
 TODO( "Leaks destroyed instances" );
 void populatePhysicalDeviceInstaceMap( const VkInstance instance ){
@@ -55,6 +68,16 @@ void populatePhysicalDeviceInstaceMap( const VkInstance instance ){
 	for( const auto pd : physicalDevices ) physicalDeviceInstanceMap[pd] = instance;
 }
 
+// device commands taking a VkCommandBuffer look up their device here
+// so command buffers that record them have to be registered after allocation, and unregistered when freed
+void registerCommandBuffers( const VkDevice device, const uint32_t count, const VkCommandBuffer* const commandBuffers ){
+	for( uint32_t i = 0; i < count; ++i ) commandBufferDeviceMap[commandBuffers[i]] = device;
+}
+
+void unregisterCommandBuffers( const uint32_t count, const VkCommandBuffer* const commandBuffers ){
+	for( uint32_t i = 0; i < count; ++i ) commandBufferDeviceMap.erase( commandBuffers[i] );
+}
+
 void loadInstanceExtensionsCommands( const VkInstance instance, const std::vector<const char*>& instanceExtensions ){
 	using std::strcmp;
 
@@ -65,6 +88,7 @@ void loadInstanceExtensionsCommands( const VkInstance instance, const std::vecto
 		if( strcmp( e, VK_EXT_DEBUG_REPORT_EXTENSION_NAME ) == 0 ) loadDebugReportCommands( instance );
 		if( strcmp( e, VK_EXT_DEBUG_UTILS_EXTENSION_NAME ) == 0 ) loadDebugUtilsCommands( instance );
 		if( strcmp( e, VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME ) == 0 ) loadExternalMemoryCapsCommands( instance );
+		if( strcmp( e, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME ) == 0 ) loadHeadlessSurfaceCommands( instance );
 		// ...
 	}
 }
@@ -77,6 +101,7 @@ void unloadInstanceExtensionsCommands( const VkInstance instance ){
 		if( strcmp( e, VK_EXT_DEBUG_REPORT_EXTENSION_NAME ) == 0 ) unloadDebugReportCommands( instance );
 		if( strcmp( e, VK_EXT_DEBUG_UTILS_EXTENSION_NAME ) == 0 ) unloadDebugUtilsCommands( instance );
 		if( strcmp( e, VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME ) == 0 ) unloadExternalMemoryCapsCommands( instance );
+		if( strcmp( e, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME ) == 0 ) unloadHeadlessSurfaceCommands( instance );
 		// ...
 	}
 
@@ -95,7 +120,10 @@ void loadDeviceExtensionsCommands( const VkDevice device, const std::vector<cons
 #ifdef VK_USE_PLATFORM_WIN32_KHR
 		if( strcmp( e, VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME ) == 0 ) loadExternalMemoryWin32Commands( device );
 #endif
+		if( strcmp( e, VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME ) == 0 ) loadGetMemoryRequirements2Commands( device );
 		if( strcmp( e, VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME ) == 0 ) loadDedicatedAllocationCommands( device );
+		if( strcmp( e, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME ) == 0 ) loadTimelineSemaphoreCommands( device );
+		if( strcmp( e, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME ) == 0 ) loadDrawIndirectCountCommands( device );
 		// ...
 	}
 }
@@ -108,7 +136,10 @@ void unloadDeviceExtensionsCommands( const VkDevice device ){
 #ifdef VK_USE_PLATFORM_WIN32_KHR
 		if( strcmp( e, VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME ) == 0 ) unloadExternalMemoryWin32Commands( device );
 #endif
+		if( strcmp( e, VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME ) == 0 ) unloadGetMemoryRequirements2Commands( device );
 		if( strcmp( e, VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME ) == 0 ) unloadDedicatedAllocationCommands( device );
+		if( strcmp( e, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME ) == 0 ) unloadTimelineSemaphoreCommands( device );
+		if( strcmp( e, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME ) == 0 ) unloadDrawIndirectCountCommands( device );
 		// ...
 	}
 
@@ -363,6 +394,34 @@ VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceExternalBufferPropertiesKHR(
 }
 
 
+// VK_EXT_headless_surface
+///////////////////////////////////////////
+
+std::unordered_map< VkInstance, PFN_vkCreateHeadlessSurfaceEXT > CreateHeadlessSurfaceEXTDispatchTable;
+
+void loadHeadlessSurfaceCommands( VkInstance instance ){
+	PFN_vkVoidFunction temp_fp;
+
+	temp_fp = vkGetInstanceProcAddr( instance, "vkCreateHeadlessSurfaceEXT" );
+	if( !temp_fp ) throw "Failed to load vkCreateHeadlessSurfaceEXT"; // check shouldn't be necessary (based on spec)
+	CreateHeadlessSurfaceEXTDispatchTable[instance] = reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>( temp_fp );
+}
+
+void unloadHeadlessSurfaceCommands( VkInstance instance ){
+	CreateHeadlessSurfaceEXTDispatchTable.erase( instance );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateHeadlessSurfaceEXT(
+	VkInstance instance,
+	const VkHeadlessSurfaceCreateInfoEXT* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator,
+	VkSurfaceKHR* pSurface
+){
+	auto dispatched_cmd = CreateHeadlessSurfaceEXTDispatchTable.at( instance );
+	return dispatched_cmd( instance, pCreateInfo, pAllocator, pSurface );
+}
+
+
 // VK_KHR_external_memory
 ///////////////////////////////////////////
 
@@ -419,6 +478,55 @@ VKAPI_ATTR VkResult VKAPI_CALL vkGetMemoryWin32HandlePropertiesKHR(
 }
 #endif
 
+// VK_KHR_get_memory_requirements2
+///////////////////////////////////////////
+
+std::unordered_map< VkDevice, PFN_vkGetBufferMemoryRequirements2KHR > GetBufferMemoryRequirements2KHRDispatchTable;
+std::unordered_map< VkDevice, PFN_vkGetImageMemoryRequirements2KHR > GetImageMemoryRequirements2KHRDispatchTable;
+std::unordered_map< VkDevice, PFN_vkGetImageSparseMemoryRequirements2KHR > GetImageSparseMemoryRequirements2KHRDispatchTable;
+
+void loadGetMemoryRequirements2Commands( VkDevice device ){
+	PFN_vkVoidFunction temp_fp;
+
+	temp_fp = vkGetDeviceProcAddr( device, "vkGetBufferMemoryRequirements2KHR" );
+	if( !temp_fp ) throw "Failed to load vkGetBufferMemoryRequirements2KHR"; // check shouldn't be necessary (based on spec)
+	GetBufferMemoryRequirements2KHRDispatchTable[device] = reinterpret_cast<PFN_vkGetBufferMemoryRequirements2KHR>( temp_fp );
+
+	temp_fp = vkGetDeviceProcAddr( device, "vkGetImageMemoryRequirements2KHR" );
+	if( !temp_fp ) throw "Failed to load vkGetImageMemoryRequirements2KHR"; // check shouldn't be necessary (based on spec)
+	GetImageMemoryRequirements2KHRDispatchTable[device] = reinterpret_cast<PFN_vkGetImageMemoryRequirements2KHR>( temp_fp );
+
+	temp_fp = vkGetDeviceProcAddr( device, "vkGetImageSparseMemoryRequirements2KHR" );
+	if( !temp_fp ) throw "Failed to load vkGetImageSparseMemoryRequirements2KHR"; // check shouldn't be necessary (based on spec)
+	GetImageSparseMemoryRequirements2KHRDispatchTable[device] = reinterpret_cast<PFN_vkGetImageSparseMemoryRequirements2KHR>( temp_fp );
+}
+
+void unloadGetMemoryRequirements2Commands( VkDevice device ){
+	GetBufferMemoryRequirements2KHRDispatchTable.erase( device );
+	GetImageMemoryRequirements2KHRDispatchTable.erase( device );
+	GetImageSparseMemoryRequirements2KHRDispatchTable.erase( device );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements2KHR( VkDevice device, const VkBufferMemoryRequirementsInfo2* pInfo, VkMemoryRequirements2* pMemoryRequirements ){
+	auto dispatched_cmd = GetBufferMemoryRequirements2KHRDispatchTable.at( device );
+	return dispatched_cmd( device, pInfo, pMemoryRequirements );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements2KHR( VkDevice device, const VkImageMemoryRequirementsInfo2* pInfo, VkMemoryRequirements2* pMemoryRequirements ){
+	auto dispatched_cmd = GetImageMemoryRequirements2KHRDispatchTable.at( device );
+	return dispatched_cmd( device, pInfo, pMemoryRequirements );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageSparseMemoryRequirements2KHR(
+	VkDevice device,
+	const VkImageSparseMemoryRequirementsInfo2* pInfo,
+	uint32_t* pSparseMemoryRequirementCount,
+	VkSparseImageMemoryRequirements2* pSparseMemoryRequirements
+){
+	auto dispatched_cmd = GetImageSparseMemoryRequirements2KHRDispatchTable.at( device );
+	return dispatched_cmd( device, pInfo, pSparseMemoryRequirementCount, pSparseMemoryRequirements );
+}
+
 // VK_KHR_dedicated_allocation
 ///////////////////////////////////////////
 
@@ -430,4 +538,81 @@ void unloadDedicatedAllocationCommands( VkDevice ){
 	// no commands
 }
 
+// VK_KHR_timeline_semaphore
+///////////////////////////////////////////
+
+std::unordered_map< VkDevice, PFN_vkGetSemaphoreCounterValueKHR > GetSemaphoreCounterValueKHRDispatchTable;
+std::unordered_map< VkDevice, PFN_vkWaitSemaphoresKHR > WaitSemaphoresKHRDispatchTable;
+std::unordered_map< VkDevice, PFN_vkSignalSemaphoreKHR > SignalSemaphoreKHRDispatchTable;
+
+void loadTimelineSemaphoreCommands( VkDevice device ){
+	PFN_vkVoidFunction temp_fp;
+
+	temp_fp = vkGetDeviceProcAddr( device, "vkGetSemaphoreCounterValueKHR" );
+	if( !temp_fp ) throw "Failed to load vkGetSemaphoreCounterValueKHR"; // check shouldn't be necessary (based on spec)
+	GetSemaphoreCounterValueKHRDispatchTable[device] = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>( temp_fp );
+
+	temp_fp = vkGetDeviceProcAddr( device, "vkWaitSemaphoresKHR" );
+	if( !temp_fp ) throw "Failed to load vkWaitSemaphoresKHR"; // check shouldn't be necessary (based on spec)
+	WaitSemaphoresKHRDispatchTable[device] = reinterpret_cast<PFN_vkWaitSemaphoresKHR>( temp_fp );
+
+	temp_fp = vkGetDeviceProcAddr( device, "vkSignalSemaphoreKHR" );
+	if( !temp_fp ) throw "Failed to load vkSignalSemaphoreKHR"; // check shouldn't be necessary (based on spec)
+	SignalSemaphoreKHRDispatchTable[device] = reinterpret_cast<PFN_vkSignalSemaphoreKHR>( temp_fp );
+}
+
+void unloadTimelineSemaphoreCommands( VkDevice device ){
+	GetSemaphoreCounterValueKHRDispatchTable.erase( device );
+	WaitSemaphoresKHRDispatchTable.erase( device );
+	SignalSemaphoreKHRDispatchTable.erase( device );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValueKHR( VkDevice device, VkSemaphore semaphore, uint64_t* pValue ){
+	auto dispatched_cmd = GetSemaphoreCounterValueKHRDispatchTable.at( device );
+	return dispatched_cmd( device, semaphore, pValue );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitSemaphoresKHR( VkDevice device, const VkSemaphoreWaitInfo* pWaitInfo, uint64_t timeout ){
+	auto dispatched_cmd = WaitSemaphoresKHRDispatchTable.at( device );
+	return dispatched_cmd( device, pWaitInfo, timeout );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkSignalSemaphoreKHR( VkDevice device, const VkSemaphoreSignalInfo* pSignalInfo ){
+	auto dispatched_cmd = SignalSemaphoreKHRDispatchTable.at( device );
+	return dispatched_cmd( device, pSignalInfo );
+}
+
+// VK_KHR_draw_indirect_count
+///////////////////////////////////////////
+
+std::unordered_map< VkDevice, PFN_vkCmdDrawIndirectCountKHR > CmdDrawIndirectCountKHRDispatchTable;
+std::unordered_map< VkDevice, PFN_vkCmdDrawIndexedIndirectCountKHR > CmdDrawIndexedIndirectCountKHRDispatchTable;
+
+void loadDrawIndirectCountCommands( VkDevice device ){
+	PFN_vkVoidFunction temp_fp;
+
+	temp_fp = vkGetDeviceProcAddr( device, "vkCmdDrawIndirectCountKHR" );
+	if( !temp_fp ) throw "Failed to load vkCmdDrawIndirectCountKHR"; // check shouldn't be necessary (based on spec)
+	CmdDrawIndirectCountKHRDispatchTable[device] = reinterpret_cast<PFN_vkCmdDrawIndirectCountKHR>( temp_fp );
+
+	temp_fp = vkGetDeviceProcAddr( device, "vkCmdDrawIndexedIndirectCountKHR" );
+	if( !temp_fp ) throw "Failed to load vkCmdDrawIndexedIndirectCountKHR"; // check shouldn't be necessary (based on spec)
+	CmdDrawIndexedIndirectCountKHRDispatchTable[device] = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>( temp_fp );
+}
+
+void unloadDrawIndirectCountCommands( VkDevice device ){
+	CmdDrawIndirectCountKHRDispatchTable.erase( device );
+	CmdDrawIndexedIndirectCountKHRDispatchTable.erase( device );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndirectCountKHR( VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride ){
+	auto dispatched_cmd = CmdDrawIndirectCountKHRDispatchTable.at( commandBufferDeviceMap.at( commandBuffer ) );
+	dispatched_cmd( commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexedIndirectCountKHR( VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride ){
+	auto dispatched_cmd = CmdDrawIndexedIndirectCountKHRDispatchTable.at( commandBufferDeviceMap.at( commandBuffer ) );
+	dispatched_cmd( commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride );
+}
+
 #endif //EXTENSION_LOADER_H
\ No newline at end of file
@@ -0,0 +1,56 @@
+// Per-frame context objects for the ring of frames in flight
+//
+// Each slot of the ring owns everything that must not be touched by the host
+// while the GPU might still be executing the frame that used the slot last.
+// The slot becomes reusable once its fence is signaled.
+
+#ifndef COMMON_FRAME_CONTEXT_H
+#define COMMON_FRAME_CONTEXT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// trivial bump (linear) allocator of host memory
+// everything allocated is released at once by reset(); no destructors are run
+class ScratchAllocator{
+	std::vector<unsigned char> storage;
+	size_t top = 0;
+
+	public:
+	explicit ScratchAllocator( size_t capacity = 0 ) : storage( capacity ){}
+
+	void* allocate( size_t size, size_t alignment = alignof( std::max_align_t ) ){
+		const auto base = reinterpret_cast<uintptr_t>( storage.data() );
+		const uintptr_t begin = (base + top + alignment - 1) / alignment * alignment;
+		const size_t newTop = static_cast<size_t>( begin - base ) + size;
+		if( newTop > storage.size() ) throw "Per-frame scratch memory exhausted! Increase frameScratchSize.";
+
+		top = newTop;
+		return reinterpret_cast<void*>( begin );
+	}
+
+	template< typename T >
+	T* allocate( size_t count = 1 ){
+		return static_cast<T*>(  allocate( sizeof( T ) * count, alignof( T ) )  );
+	}
+
+	void reset(){ top = 0; }
+
+	size_t used() const{ return top; }
+	size_t capacity() const{ return storage.size(); }
+};
+
+struct FrameContext{
+	VkFence fence; // signaled when the GPU finished the last submission that used this slot; NULL if paced by timeline semaphore
+	uint64_t submissionSerial; // serial of the last submission that used this slot; also the frame timeline semaphore value it signals
+	VkSemaphore imageReadyS; // signaled by vkAcquireNextImageKHR
+	VkCommandPool commandPool; // transient pool; reset as a whole each time the slot is reused
+	VkCommandBuffer commandBuffer;
+	bool queriesPending; // the last submission wrote GPU queries (timestamps, pipeline statistics) of a measured frame that were not read back yet
+	ScratchAllocator scratch; // host memory that lives until the slot is reused
+};
+
+#endif //COMMON_FRAME_CONTEXT_H
@@ -0,0 +1,139 @@
+// Per-frame measurements and their summary as JSON report
+//
+// Each named series collects one sample per frame (e.g. CPU frame time in ms).
+// The report summarizes every series with percentiles, so runs of different
+// builds or machines can be compared by scripts.
+
+#ifndef COMMON_FRAME_STATISTICS_H
+#define COMMON_FRAME_STATISTICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class FrameStatistics{
+	struct Series{
+		std::string name;
+		std::string unit;
+		std::vector<double> samples;
+	};
+
+	// few entries, so linear search is fine; keeps insertion order for the report
+	std::vector<Series> series;
+	std::vector< std::pair<std::string, uint64_t> > counters;
+	std::vector< std::pair<std::string, double> > metrics; // single measured values, not per frame
+	std::vector< std::pair<std::string, std::string> > properties;
+
+	Series& getSeries( const std::string& name, const std::string& unit ){
+		for( auto& s : series ) if( s.name == name ) return s;
+		series.push_back( {name, unit, {}} );
+		return series.back();
+	}
+
+	template< typename T >
+	static void setValue( std::vector< std::pair<std::string, T> >& values, const std::string& name, T value ){
+		for( auto& v : values ) if( v.first == name ){ v.second = std::move( value ); return; }
+		values.emplace_back( name, std::move( value ) );
+	}
+
+	// nearest-rank percentile of sorted samples
+	static double percentile( const std::vector<double>& sorted, const double p ){
+		if( sorted.empty() ) return 0.0;
+		const size_t rank = static_cast<size_t>(  std::ceil( p / 100.0 * static_cast<double>( sorted.size() ) )  );
+		return sorted[std::min( std::max( rank, size_t( 1 ) ), sorted.size() ) - 1];
+	}
+
+	static std::string jsonString( const std::string& s ){
+		std::string escaped = "\"";
+		for( const char c : s ){
+			switch( c ){
+				case '"': escaped += "\\\""; break;
+				case '\\': escaped += "\\\\"; break;
+				case '\n': escaped += "\\n"; break;
+				case '\t': escaped += "\\t"; break;
+				default:
+					if( static_cast<unsigned char>( c ) < 0x20 ){
+						char code[8];
+						std::snprintf( code, sizeof( code ), "\\u%04x", static_cast<unsigned>( c ) );
+						escaped += code;
+					}
+					else escaped += c;
+			}
+		}
+		return escaped + "\"";
+	}
+
+	public:
+	void addSample( const std::string& name, const double value, const std::string& unit = "ms" ){
+		getSeries( name, unit ).samples.push_back( value );
+	}
+
+	void setCounter( const std::string& name, const uint64_t value ){ setValue( counters, name, value ); }
+	void setMetric( const std::string& name, const double value ){ setValue( metrics, name, value ); }
+	void setProperty( const std::string& name, std::string value ){ setValue( properties, name, std::move( value ) ); }
+
+	size_t sampleCount( const std::string& name ) const{
+		for( const auto& s : series ) if( s.name == name ) return s.samples.size();
+		return 0;
+	}
+
+	void clear(){
+		series.clear();
+		counters.clear();
+		metrics.clear();
+		properties.clear();
+	}
+
+	void writeJson( std::ostream& out ) const{
+		out << "{\n";
+
+		out << "\t\"properties\": {";
+		for( size_t i = 0; i < properties.size(); ++i ){
+			out << (i ? ",\n" : "\n") << "\t\t" << jsonString( properties[i].first ) << ": " << jsonString( properties[i].second );
+		}
+		out << (properties.empty() ? "" : "\n\t") << "},\n";
+
+		out << "\t\"counters\": {";
+		for( size_t i = 0; i < counters.size(); ++i ){
+			out << (i ? ",\n" : "\n") << "\t\t" << jsonString( counters[i].first ) << ": " << counters[i].second;
+		}
+		out << (counters.empty() ? "" : "\n\t") << "},\n";
+
+		out << "\t\"metrics\": {";
+		for( size_t i = 0; i < metrics.size(); ++i ){
+			out << (i ? ",\n" : "\n") << "\t\t" << jsonString( metrics[i].first ) << ": " << metrics[i].second;
+		}
+		out << (metrics.empty() ? "" : "\n\t") << "},\n";
+
+		out << "\t\"series\": {";
+		for( size_t i = 0; i < series.size(); ++i ){
+			std::vector<double> sorted = series[i].samples;
+			std::sort( sorted.begin(), sorted.end() );
+
+			double total = 0.0;
+			for( const double sample : sorted ) total += sample;
+			const double mean = sorted.empty() ? 0.0 : total / static_cast<double>( sorted.size() );
+
+			out << (i ? ",\n" : "\n") << "\t\t" << jsonString( series[i].name ) << ": { "
+			    << "\"unit\": " << jsonString( series[i].unit )
+			    << ", \"count\": " << sorted.size()
+			    << ", \"mean\": " << mean
+			    << ", \"p50\": " << percentile( sorted, 50.0 )
+			    << ", \"p95\": " << percentile( sorted, 95.0 )
+			    << ", \"p99\": " << percentile( sorted, 99.0 )
+			    << ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back())
+			    << ", \"total\": " << total
+			    << " }";
+		}
+		out << (series.empty() ? "" : "\n\t") << "}\n";
+
+		out << "}\n";
+	}
+};
+
+#endif //COMMON_FRAME_STATISTICS_H
@@ -0,0 +1,63 @@
+// Deferred destruction of objects that might still be in use by the GPU
+//
+// Objects are buried together with the serial number of the last submission
+// that might use them. They are killed only after that submission has been
+// observed to be finished, so nobody has to wait for the device to go idle.
+// Use that is not ordered with the submissions (e.g. presents on a separate
+// queue) is tracked by an extra released condition, e.g. a fence status.
+
+#ifndef COMMON_GRAVEYARD_H
+#define COMMON_GRAVEYARD_H
+
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+class Graveyard{
+	struct Grave{
+		uint64_t serial;
+		std::function<bool(void)> released; // can be empty
+		std::function<void(void)> kill;
+	};
+
+	std::deque<Grave> graves; // ordered by serial
+
+	public:
+	// kill is called once the submission with the serial (and so all before it) is finished
+	// serials have to be buried in non-decreasing order; objects of the same serial are killed in the order they were buried
+	void bury( uint64_t serial, std::function<void(void)> kill ){
+		bury( serial, nullptr, std::move( kill ) );
+	}
+
+	// as above, and additionally only once released() returns true; the graves after it wait for it too
+	void bury( uint64_t serial, std::function<bool(void)> released, std::function<void(void)> kill ){
+		assert( graves.empty() || graves.back().serial <= serial );
+		graves.push_back(  { serial, std::move( released ), std::move( kill ) }  );
+	}
+
+	// kills everything that is not in use by submissions later than completedSerial, and is released
+	void collect( uint64_t completedSerial ){
+		collect( completedSerial, true );
+	}
+
+	// only valid when the device is known to be idle
+	void collectAll(){
+		collect( UINT64_MAX, false );
+	}
+
+	bool empty() const{ return graves.empty(); }
+	size_t size() const{ return graves.size(); }
+
+	private:
+	void collect( uint64_t completedSerial, bool checkReleased ){
+		while(  !graves.empty() && graves.front().serial <= completedSerial && ( !checkReleased || !graves.front().released || graves.front().released() )  ){
+			const auto kill = std::move( graves.front().kill );
+			graves.pop_front();
+			kill();
+		}
+	}
+};
+
+#endif //COMMON_GRAVEYARD_H
@@ -12,6 +12,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -19,9 +20,11 @@
 #include <fstream>
 #include <functional>
 #include <iterator>
+#include <new>
 #include <stdexcept>
 #include <string>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -31,7 +34,20 @@ static_assert( VK_HEADER_VERSION >= REQUIRED_HEADER_VERSION, "Update your SDK! T
 #include "EnumerateScheme.h"
 #include "ErrorHandling.h"
 #include "ExtensionLoader.h"
+#include "FrameContext.h"
+#include "FrameStatistics.h"
+#include "Graveyard.h"
+#include "HostUpload.h"
+#include "MappedFile.h"
+#include "MemoryAllocator.h"
+#include "MemoryTelemetry.h"
+#include "MeshFile.h"
+#include "Profiler.h"
+#include "StagingUploader.h"
+#include "StreamingBuffer.h"
 #include "Vertex.h"
+#include "VertexCacheOptimizer.h"
+#include "VertexInput.h"
 #include "Wsi.h"
 
 
@@ -76,6 +92,80 @@ constexpr uint32_t initialWindowHeight = 800;
 constexpr VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
 //constexpr VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
 
+// swapchain is recreated only once the window size did not change for this long (e.g. during live resize); 0 to disable
+constexpr std::chrono::milliseconds resizeDebounce{ 0 };
+
+// frames in flight
+// more frames in flight trade latency for throughput (CPU and GPU can work further apart)
+// can be overriden at runtime by the HELLO_TRIANGLE_FRAMES_IN_FLIGHT environment variable
+constexpr uint32_t framesInFlight = 2;
+constexpr uint32_t maxFramesInFlight = 8;
+constexpr size_t frameScratchSize = 4 * 1024; // bytes of per-frame host scratch memory, for the arrays the frame's commands are recorded from
+constexpr VkDeviceSize streamingRegionSize = 256 * 1024; // bytes of the streaming buffer per frame in flight (vertices, indices, uniforms written every frame)
+
+// device memory is allocated in blocks of this size (power of two), and resources are sub-allocated from them
+// resources bigger than half a block get their own allocation
+constexpr VkDeviceSize memoryBlockSize = 64 * 1024 * 1024;
+// resources the driver prefers or requires to be dedicated get their own allocation (VK_KHR_dedicated_allocation, if supported)
+constexpr bool useDedicatedAllocation = true;
+// frames between samples of the memory budget (VK_EXT_memory_budget if supported); 0 samples only at exit
+constexpr uint64_t memoryTelemetryPeriod = 300;
+// warn when a heap's usage goes over this part of its budget
+constexpr double memoryBudgetWarningRatio = 0.9;
+
+// uploads into device local memory go through staging buffers of this size
+constexpr VkDeviceSize stagingBufferSize = 1024 * 1024;
+// upload on a dedicated transfer-only queue family (DMA engine) if there is one; graphics queue otherwise
+constexpr bool useTransferQueue = true;
+
+// write the triangle every frame through the streaming buffer instead of drawing the static vertex buffer
+constexpr bool streamVertexData = false;
+
+// triangle vertices as SNORM16 positions and UNORM8 colors (8 B instead of 20 B); mesh files carry their own layout
+constexpr bool useQuantizedVertices = false;
+
+// reorder the triangles (Tipsify) and then the vertices of indexed meshes at load time, for the post-transform vertex cache and the vertex fetch
+// the mesh is read into memory for it, so only meshes whose estimated working set is up to maxOptimizedMeshSize are; bigger ones are streamed from the file as they are
+constexpr bool optimizeMeshes = true;
+constexpr uint32_t vertexCacheSize = 16; // entries of the simulated post-transform cache
+constexpr uint64_t maxOptimizedMeshSize = (sizeof( void* ) < 8 ? 256ull : 2048ull) * 1024 * 1024; // bytes of the mesh copy and the optimizer's arrays; less of the address space on 32-bit
+
+// instanced mode -- draws a grid of this many copies of the triangle (or mesh) in one draw; 0 draws a single one without instancing
+// can be overriden at runtime by the HELLO_TRIANGLE_INSTANCES environment variable
+constexpr uint32_t instanceCount = 0;
+constexpr uint32_t maxInstanceCount = 16 * 1024 * 1024; // 256 MiB of instance data
+
+// GPU-driven drawing -- a compute pre-pass writes the frame's draw commands and their count, and the render pass draws them indirectly
+// with vkCmdDrawIndirectCountKHR (VK_KHR_draw_indirect_count) if supported, vkCmdDrawIndirect otherwise; the CPU cost does not depend on what is drawn
+constexpr bool gpuDrivenDraws = false;
+// instances per draw command; raised if there would be more commands than maxDrawIndirectCount
+constexpr uint32_t instancesPerDrawCommand = 1024;
+// with GPU-driven instanced draws, a compute pass first drops the instances outside of the viewport or too small to cover a pixel
+constexpr bool gpuCulling = true;
+
+// offscreen rendering (USE_PLATFORM_NONE)
+// color format of the render targets; B8G8R8A8_UNORM is guaranteed to support color attachment usage
+constexpr VkFormat offscreenFormat = VK_FORMAT_B8G8R8A8_UNORM;
+
+// pace the frames with a single VK_KHR_timeline_semaphore value per submission if supported; binary fences otherwise
+constexpr bool useTimelineSemaphore = true;
+
+// benchmark mode -- enabled by --benchmark-frames N (or HELLO_TRIANGLE_BENCHMARK_FRAMES=N)
+// renders warm-up frames, then the measured frames, writes the JSON report and quits
+constexpr uint64_t defaultBenchmarkWarmupFrames = 100;
+// GPU time of the measured frames via timestamp queries around the render pass
+constexpr bool gpuTimestamps = true;
+// vertex shader invocations, clipping primitives and fragment shader invocations of the measured frames (needs pipelineStatisticsQuery feature)
+constexpr bool pipelineStatistics = false;
+// host to mapped memory copy bandwidth (memcpy vs non-temporal stores) per host visible memory type, measured before the frames
+constexpr bool benchmarkHostUploads = true;
+constexpr VkDeviceSize hostUploadBenchmarkSize = 16 * 1024 * 1024;
+constexpr uint32_t hostUploadBenchmarkRepetitions = 20;
+
+// pipeline cache persisted between runs (in the working directory)
+constexpr bool usePipelineCache = true;
+const char pipelineCacheFilename[] = u8"HelloTriangle.pipelinecache";
+
 // pipeline settings
 constexpr VkClearValue clearColor = {  { {0.1f, 0.1f, 0.1f, 1.0f} }  };
 
@@ -85,11 +175,21 @@ constexpr bool forceSeparatePresentQueue = false;
 // needed stuff for main() -- forward declarations
 //////////////////////////////////////////////////////////////////////////////////
 
+struct BenchmarkSettings{
+	uint64_t warmupFrames;
+	uint64_t measuredFrames; // 0 if benchmark mode is off
+	string reportFilename; // report goes to the log if empty
+};
+// from command line arguments, or HELLO_TRIANGLE_BENCHMARK_* environment variables if not given there
+// unknown arguments are ignored with a warning; a malformed value of a known one throws
+BenchmarkSettings getBenchmarkSettings( const vector<string>& arguments );
+
 bool isLayerSupported( const char* layer, const vector<VkLayerProperties>& supportedLayers );
 bool isExtensionSupported( const char* extension, const vector<VkExtensionProperties>& supportedExtensions );
 // treat layers as optional; app can always run without em -- i.e. return those supported
 vector<const char*> checkInstanceLayerSupport( const vector<const char*>& requestedLayers, const vector<VkLayerProperties>& supportedLayers );
 vector<VkExtensionProperties> getSupportedInstanceExtensions( const vector<const char*>& providingLayers );
+vector<VkExtensionProperties> getSupportedDeviceExtensions( VkPhysicalDevice physDevice, const vector<const char*>& providingLayers );
 bool checkExtensionSupport( const vector<const char*>& extensions, const vector<VkExtensionProperties>& supportedExtensions );
 
 VkInstance initInstance( const vector<const char*>& layers = {}, const vector<const char*>& extensions = {} );
@@ -98,17 +198,27 @@ void killInstance( VkInstance instance );
 VkPhysicalDevice getPhysicalDevice( VkInstance instance, VkSurfaceKHR surface = VK_NULL_HANDLE /*seek presentation support if !NULL*/ ); // destroyed with instance
 VkPhysicalDeviceProperties getPhysicalDeviceProperties( VkPhysicalDevice physicalDevice );
 VkPhysicalDeviceMemoryProperties getPhysicalDeviceMemoryProperties( VkPhysicalDevice physicalDevice );
+VkPhysicalDeviceFeatures getPhysicalDeviceFeatures( VkPhysicalDevice physicalDevice );
+// needs VK_KHR_get_physical_device_properties2 enabled on the instance
+bool isTimelineSemaphoreSupported( VkPhysicalDevice physicalDevice, const vector<const char*>& providingLayers );
+// VK_EXT_swapchain_maintenance1 with its feature; needs VK_KHR_get_physical_device_properties2
+bool isSwapchainMaintenance1Supported( VkPhysicalDevice physicalDevice, const vector<const char*>& providingLayers );
 
+// without surface the present queue family is just the graphics one
 std::pair<uint32_t, uint32_t> getQueueFamilies( VkPhysicalDevice physDevice, VkSurfaceKHR surface );
 vector<VkQueueFamilyProperties> getQueueFamilyProperties( VkPhysicalDevice device );
+// transfer-only queue family if there is one (and useTransferQueue), graphicsQueueFamily otherwise
+uint32_t getTransferQueueFamily( VkPhysicalDevice physDevice, uint32_t graphicsQueueFamily );
 
 VkDevice initDevice(
 	VkPhysicalDevice physDevice,
 	const VkPhysicalDeviceFeatures& features,
 	uint32_t graphicsQueueFamily,
 	uint32_t presentQueueFamily,
+	uint32_t transferQueueFamily,
 	const vector<const char*>& layers = {},
-	const vector<const char*>& extensions = {}
+	const vector<const char*>& extensions = {},
+	const void* featuresChain = nullptr // extension feature structs to be chained into VkDeviceCreateInfo::pNext
 );
 void killDevice( VkDevice device );
 
@@ -117,19 +227,26 @@ VkQueue getQueue( VkDevice device, uint32_t queueFamily, uint32_t queueIndex );
 
 enum class ResourceType{ Buffer, Image };
 
+// sub-allocates from the first memory type (by memoryTypePriority) the resource supports, and binds it
+// resources the driver prefers or requires to be dedicated get their own allocation instead
 template< ResourceType resourceType, class T >
-VkDeviceMemory initMemory(
+MemoryAllocation initMemory(
 	VkDevice device,
-	VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties,
+	DeviceMemoryAllocator& allocator,
 	T resource,
 	const std::vector<VkMemoryPropertyFlags>& memoryTypePriority
 );
-void setMemoryData( VkDevice device, VkDeviceMemory memory, void* begin, size_t size );
-void killMemory( VkDevice device, VkDeviceMemory memory );
+// copies with non-temporal stores into write-combined memory, and flushes non-coherent memory
+void setMemoryData( DeviceMemoryAllocator& allocator, const MemoryAllocation& memory, void* begin, size_t size );
+void killMemory( DeviceMemoryAllocator& allocator, const MemoryAllocation& memory );
 
-VkBuffer initBuffer( VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage );
+// CONCURRENT sharing if queueFamilies has more than one distinct family
+VkBuffer initBuffer( VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, vector<uint32_t> queueFamilies = {} );
 void killBuffer( VkDevice device, VkBuffer buffer );
 
+// GB/s samples of each copy path into each host visible memory type
+void measureHostUploadBandwidth( VkDevice device, DeviceMemoryAllocator& allocator, FrameStatistics& statistics );
+
 VkImage initImage(
 	VkDevice device,
 	VkFormat format,
@@ -166,7 +283,7 @@ vector<VkImageView> initSwapchainImageViews( VkDevice device, vector<VkImage> im
 void killSwapchainImageViews( VkDevice device, vector<VkImageView>& imageViews );
 
 
-VkRenderPass initRenderPass( VkDevice device, VkSurfaceFormatKHR surfaceFormat );
+VkRenderPass initRenderPass( VkDevice device, VkFormat colorFormat, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR );
 void killRenderPass( VkDevice device, VkRenderPass renderPass );
 
 vector<VkFramebuffer> initFramebuffers(
@@ -183,36 +300,85 @@ VkShaderModule initShaderModule( VkDevice device, string filename );
 void killShaderModule( VkDevice device, VkShaderModule shaderModule );
 
 VkPipelineLayout initPipelineLayout( VkDevice device );
+VkPipelineLayout initPipelineLayout( VkDevice device, VkDescriptorSetLayout descriptorSetLayout, VkShaderStageFlags pushConstantStages, uint32_t pushConstantSize );
 void killPipelineLayout( VkDevice device, VkPipelineLayout pipelineLayout );
 
+// checks the VkPipelineCacheHeaderVersionOne of serialized cache data against the physical device
+bool isPipelineCacheDataCompatible( const void* data, size_t dataSize, const VkPhysicalDeviceProperties& properties );
+VkPipelineCache initPipelineCache( VkDevice device, const void* initialData = nullptr, size_t initialDataSize = 0 );
+// returns the cache and whether it was prepopulated from the file (i.e. is warm)
+std::pair<VkPipelineCache, bool> loadPipelineCache( VkDevice device, const VkPhysicalDeviceProperties& properties, const string& filename );
+// merges in what the file got meanwhile (e.g. from other instance of the app) and atomically replaces it
+void savePipelineCache( VkDevice device, VkPipelineCache pipelineCache, const VkPhysicalDeviceProperties& properties, const string& filename );
+void killPipelineCache( VkDevice device, VkPipelineCache pipelineCache );
+
 VkPipeline initPipeline(
 	VkDevice device,
+	VkPipelineCache pipelineCache,
 	VkPhysicalDeviceLimits limits,
 	VkPipelineLayout pipelineLayout,
 	VkRenderPass renderPass,
 	VkShaderModule vertexShader,
 	VkShaderModule fragmentShader,
 	const uint32_t vertexBufferBinding,
-	uint32_t width, uint32_t height
-);
+	VertexLayout vertexLayout,
+	bool instanced, // adds the Instance2D_ColorU8 binding; vertexShader has to take the instance inputs
+	const uint32_t instanceBufferBinding
+); // viewport and scissor are dynamic state, so the pipeline does not depend on the swapchain
 void killPipeline( VkDevice device, VkPipeline pipeline );
 
 
-void setVertexData( VkDevice device, VkDeviceMemory memory, vector<Vertex2D_ColorF_pack> vertices );
+template< typename Vertex >
+void setVertexData( StagingUploader& uploader, VkBuffer buffer, const vector<Vertex>& vertices );
+// streams the chunks from the file mapping straight into the staging memory; indexBuffer is ignored if the mesh has no indices
+// throws string if an index is out of the vertex range
+void setMeshData( StagingUploader& uploader, const MeshFile& mesh, VkBuffer vertexBuffer, VkBuffer indexBuffer );
+
+struct OptimizedMesh{
+	vector<unsigned char> vertices;
+	vector<unsigned char> indices; // of the mesh's index size
+	VertexCacheStats before;
+	VertexCacheStats after;
+};
+// reads the whole indexed triangle list mesh and reorders it for the vertex cache and fetch; throws string if an index is out of range
+OptimizedMesh loadOptimizedMesh( const MeshFile& mesh, uint32_t cacheSize );
+
+// config value possibly overriden by HELLO_TRIANGLE_INSTANCES env variable, clamped to 0..maxInstanceCount
+uint32_t getInstanceCount();
+// square grid covering the viewport; each copy scaled to fit its cell, given the model spans modelSize in clip space
+vector<Instance2D_ColorU8> generateInstanceGrid( uint32_t count, float modelSize );
 
 VkSemaphore initSemaphore( VkDevice device );
 vector<VkSemaphore> initSemaphores( VkDevice device, size_t count );
 void killSemaphore( VkDevice device, VkSemaphore semaphore );
 void killSemaphores( VkDevice device, vector<VkSemaphore>& semaphores );
 
-VkCommandPool initCommandPool( VkDevice device, const uint32_t queueFamily );
+// needs VK_KHR_timeline_semaphore
+VkSemaphore initTimelineSemaphore( VkDevice device, uint64_t initialValue = 0 );
+void waitTimelineSemaphore( VkDevice device, VkSemaphore timelineS, uint64_t value );
+uint64_t getTimelineSemaphoreValue( VkDevice device, VkSemaphore timelineS );
+
+VkCommandPool initCommandPool( VkDevice device, const uint32_t queueFamily, VkCommandPoolCreateFlags flags = 0 );
 void killCommandPool( VkDevice device, VkCommandPool commandPool );
 
+VkFence initFence( VkDevice device, VkFenceCreateFlags flags = 0 );
+void killFence( VkDevice device, VkFence fence );
 vector<VkFence> initFences( VkDevice device, size_t count, VkFenceCreateFlags flags = 0 );
 void killFences( VkDevice device, vector<VkFence>& fences );
 
+// config value possibly overriden by HELLO_TRIANGLE_FRAMES_IN_FLIGHT env variable, clamped to 1..maxFramesInFlight
+uint32_t getFramesInFlight();
+vector<FrameContext> initFrameContexts( VkDevice device, uint32_t queueFamily, uint32_t count, bool withFences );
+void killFrameContexts( VkDevice device, vector<FrameContext>& frames );
+
+VkQueryPool initQueryPool( VkDevice device, VkQueryType queryType, uint32_t count, VkQueryPipelineStatisticFlags pipelineStatistics = 0 );
+void killQueryPool( VkDevice device, VkQueryPool queryPool );
+// 64-bit results without waiting; returns false if they are not available yet
+// valuesPerQuery is the number of enabled statistics for VK_QUERY_TYPE_PIPELINE_STATISTICS, otherwise 1
+bool getQueryResults( VkDevice device, VkQueryPool queryPool, uint32_t firstQuery, uint32_t count, uint64_t* results, uint32_t valuesPerQuery = 1 );
+
 void acquireCommandBuffers( VkDevice device, VkCommandPool commandPool, uint32_t count, vector<VkCommandBuffer>& commandBuffers );
-void beginCommandBuffer( VkCommandBuffer commandBuffer );
+void beginCommandBuffer( VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags usage = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT );
 void endCommandBuffer( VkCommandBuffer commandBuffer );
 
 void recordBeginRenderPass(
@@ -224,13 +390,73 @@ void recordBeginRenderPass(
 );
 void recordEndRenderPass( VkCommandBuffer commandBuffer );
 
-void recordBindPipeline( VkCommandBuffer commandBuffer, VkPipeline pipeline );
-void recordBindVertexBuffer( VkCommandBuffer commandBuffer, const uint32_t vertexBufferBinding, VkBuffer vertexBuffer );
-
-void recordDraw( VkCommandBuffer commandBuffer, uint32_t vertexCount );
+void recordResetQueries( VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t count );
+void recordWriteTimestamp( VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, VkQueryPool queryPool, uint32_t query );
+void recordBeginQuery( VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t query );
+void recordEndQuery( VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t query );
 
-void submitToQueue( VkQueue queue, VkCommandBuffer commandBuffer, VkSemaphore imageReadyS, VkSemaphore renderDoneS, VkFence fence = VK_NULL_HANDLE );
-void present( VkQueue queue, VkSwapchainKHR swapchain, uint32_t swapchainImageIndex, VkSemaphore renderDoneS );
+void recordBindPipeline( VkCommandBuffer commandBuffer, VkPipeline pipeline );
+void recordSetViewport( VkCommandBuffer commandBuffer, uint32_t width, uint32_t height ); // and scissor
+void recordBindVertexBuffer( VkCommandBuffer commandBuffer, const uint32_t vertexBufferBinding, VkBuffer vertexBuffer, VkDeviceSize offset = 0 );
+
+void recordBindIndexBuffer( VkCommandBuffer commandBuffer, VkBuffer indexBuffer, VkIndexType indexType );
+
+void recordDraw( VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount = 1 );
+void recordDrawIndexed( VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount = 1 );
+
+// GPU-driven draws (shaders/hello_triangle_cull.comp and shaders/hello_triangle_draws.comp)
+// each region of the draw command buffer is the draw count and the surviving instance count (padded), followed by the records
+constexpr VkDeviceSize drawCountSize = 16;
+constexpr VkDeviceSize survivingInstancesOffset = 4; // in the region
+constexpr uint32_t computeWorkgroupSize = 64; // local_size_x of the compute shaders
+struct DrawCommandParameters{ // push constants
+	uint32_t commandCount;
+	uint32_t instanceCount;
+	uint32_t instancesPerCommand;
+	uint32_t elementCount; // vertices, or indices if indexed
+	uint32_t indexed; // VkDrawIndexedIndirectCommand records instead of VkDrawIndirectCommand
+	uint32_t culled; // draw only the instances that survived the culling pass
+};
+struct CullParameters{ // push constants
+	float modelMin[2]; // bounds of the model, before the instance's scale and offset
+	float modelMax[2];
+	float viewportSize[2];
+	uint32_t instanceCount;
+	uint32_t padding;
+};
+
+VkDescriptorSetLayout initDescriptorSetLayout( VkDevice device, const vector<VkDescriptorType>& bindingTypes, VkShaderStageFlags stages ); // binding i has a single descriptor of bindingTypes[i]
+void killDescriptorSetLayout( VkDevice device, VkDescriptorSetLayout descriptorSetLayout );
+VkDescriptorPool initDescriptorPool( VkDevice device, const vector<VkDescriptorType>& bindingTypes, uint32_t setCount ); // for sets of such a layout
+void killDescriptorPool( VkDevice device, VkDescriptorPool descriptorPool ); // frees its sets too
+VkDescriptorSet allocateDescriptorSet( VkDevice device, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout );
+void writeBufferDescriptor( VkDevice device, VkDescriptorSet descriptorSet, uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range );
+
+VkPipeline initComputePipeline( VkDevice device, VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout, VkShaderModule computeShader );
+
+void recordFillBuffer( VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t value );
+void recordCopyBuffer( VkCommandBuffer commandBuffer, VkBuffer source, VkDeviceSize sourceOffset, VkBuffer destination, VkDeviceSize destinationOffset, VkDeviceSize size );
+// global; covers all the resources
+void recordMemoryBarrier( VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess );
+void recordBindComputeDescriptorSet( VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets );
+// one invocation per item, in workgroups of computeWorkgroupSize
+// more than maxWorkgroupCountX workgroups are laid out in rows; the shaders take item gl_GlobalInvocationID.y * rowWidth + gl_GlobalInvocationID.x
+void recordDispatch( VkCommandBuffer commandBuffer, VkPipeline pipeline, VkPipelineLayout pipelineLayout, const void* pushConstants, uint32_t pushConstantsSize, uint32_t itemCount, uint32_t maxWorkgroupCountX );
+// countBuffer can be NULL: then all maxDrawCount records are drawn (the ones not written are zero, so they draw nothing)
+void recordDrawIndirect( VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t maxDrawCount, uint32_t stride, bool indexed, VkBuffer countBuffer, VkDeviceSize countOffset );
+
+// imageReadyS and renderDoneS can be NULL (offscreen rendering)
+// timelineS (if not NULL) is additionally signaled to timelineValue
+void submitToQueue(
+	VkQueue queue,
+	VkCommandBuffer commandBuffer,
+	VkSemaphore imageReadyS,
+	VkSemaphore renderDoneS,
+	VkFence fence = VK_NULL_HANDLE,
+	VkSemaphore timelineS = VK_NULL_HANDLE, uint64_t timelineValue = 0
+);
+// presentFence (VK_EXT_swapchain_maintenance1) can be NULL
+void present( VkQueue queue, VkSwapchainKHR swapchain, uint32_t swapchainImageIndex, VkSemaphore renderDoneS, VkFence presentFence = VK_NULL_HANDLE );
 
 // cleanup dangerous semaphore with signal pending from vkAcquireNextImageKHR
 void cleanupUnsafeSemaphore( VkQueue queue, VkSemaphore semaphore );
@@ -239,8 +465,17 @@ void cleanupUnsafeSemaphore( VkQueue queue, VkSemaphore semaphore );
 // main()!
 //////////////////////////////////////////////////////////////////////////////////
 
-int helloTriangle() try{
+int helloTriangle( const vector<string>& arguments ) try{
+	using Clock = std::chrono::steady_clock;
+	const auto toMilliseconds = []( Clock::duration d ){ return std::chrono::duration<double, std::milli>( d ).count(); };
+	const auto startupBegin = Clock::now();
+
+	const BenchmarkSettings benchmark = getBenchmarkSettings( arguments );
+	const bool benchmarking = benchmark.measuredFrames > 0;
+	if( benchmarking ) logger << "INFO: Benchmarking " << benchmark.measuredFrames << " frame(s) after " << benchmark.warmupFrames << " warm-up frame(s)." << std::endl;
+
 	const uint32_t vertexBufferBinding = 0;
+	const uint32_t instanceBufferBinding = 1;
 
 	const float triangleSize = 1.6f;
 	const vector<Vertex2D_ColorF_pack> triangle = {
@@ -249,6 +484,77 @@ int helloTriangle() try{
 		{ /*lb*/ { {-0.5f * triangleSize,  sqrtf( 3.0f ) * 0.25f * triangleSize} }, /*B*/{ {0.0f, 0.0f, 1.0f} }  }
 	};
 
+	// HELLO_TRIANGLE_EXPORT_MESH=file writes the triangle as an indexed mesh file, e.g. as a starting point for HELLO_TRIANGLE_MESH
+	const char* const exportMeshFilename = std::getenv( "HELLO_TRIANGLE_EXPORT_MESH" );
+	if( exportMeshFilename && *exportMeshFilename ){
+		const uint16_t triangleIndices[] = { 0, 1, 2 };
+		const bool exported = writeMeshFile(
+			exportMeshFilename,
+			VertexLayout::Position2D_ColorF, sizeof( Vertex2D_ColorF_pack ), triangle.data(), triangle.size(),
+			sizeof( uint16_t ), triangleIndices, sizeof( triangleIndices ) / sizeof( triangleIndices[0] )
+		);
+		if( exported ) logger << "INFO: Triangle exported as mesh file " << exportMeshFilename << "." << std::endl;
+		else logger << "WARNING: Failed to export the triangle as mesh file " << exportMeshFilename << "." << std::endl;
+	}
+
+	// HELLO_TRIANGLE_MESH=file draws the mesh from the file instead of the triangle
+	const char* const meshFilename = std::getenv( "HELLO_TRIANGLE_MESH" );
+	const MeshFile mesh = meshFilename && *meshFilename ? MeshFile( meshFilename ) : MeshFile();
+	if( !mesh.empty() ){
+		const MeshFileHeader& header = mesh.getHeader();
+		const uint32_t stride = getVertexStride( static_cast<VertexLayout>( header.vertexLayout ) );
+		if( !stride || header.vertexStride != stride ){
+			throw string( "Mesh file " ) + meshFilename + " has a vertex layout the pipeline does not support!";
+		}
+		if( !header.vertexCount || header.vertexCount > UINT32_MAX || header.indexCount > UINT32_MAX ) throw string( "Mesh file " ) + meshFilename + " has too few or too many vertices or indices!";
+
+		logger << "INFO: Mesh " << meshFilename << ": " << header.vertexCount << " vertices, " << header.indexCount << " indices in " << header.chunkCount << " chunk(s)." << std::endl;
+	}
+
+	OptimizedMesh optimizedMesh;
+	bool meshOptimized = false;
+	if( ::optimizeMeshes && !mesh.empty() && mesh.getHeader().indexCount ){
+		const MeshFileHeader& header = mesh.getHeader();
+		if( header.indexCount % 3 ) logger << "WARNING: Mesh index count is not a multiple of 3; it is drawn without the vertex cache optimization." << std::endl;
+		else if( estimateMeshOptimizationMemory( header.vertexCount, header.vertexStride, header.indexCount, header.indexSize ) > ::maxOptimizedMeshSize ){
+			logger << "WARNING: Mesh optimization would need more than maxOptimizedMeshSize; it is streamed without the vertex cache optimization." << std::endl;
+		}
+		else{
+			try{
+				optimizedMesh = loadOptimizedMesh( mesh, ::vertexCacheSize );
+				meshOptimized = true;
+				logger << "INFO: Mesh reordered for a " << ::vertexCacheSize << " entry vertex cache: ACMR " << optimizedMesh.before.acmr << " -> " << optimizedMesh.after.acmr
+				       << ", ATVR " << optimizedMesh.before.atvr << " -> " << optimizedMesh.after.atvr << "." << std::endl;
+			}
+			catch( const std::bad_alloc& ){
+				optimizedMesh = OptimizedMesh();
+				logger << "WARNING: Out of memory for the mesh optimization; it is streamed without the vertex cache optimization." << std::endl;
+			}
+		}
+	}
+	const VertexLayout vertexLayout = !mesh.empty() ? static_cast<VertexLayout>( mesh.getHeader().vertexLayout )
+		: useQuantizedVertices ? VertexLayout::Position2D_S16_ColorU8 : VertexLayout::Position2D_ColorF;
+	const uint32_t vertexStride = getVertexStride( vertexLayout );
+
+	QuantizationError quantizationError;
+	const vector<Vertex2D_S16_ColorU8_pack> quantizedTriangle = useQuantizedVertices ? quantizeVertices( triangle, &quantizationError ) : vector<Vertex2D_S16_ColorU8_pack>();
+	if( useQuantizedVertices ){
+		logger << "INFO: Triangle quantized to " << sizeof( Vertex2D_S16_ColorU8_pack ) << " B per vertex; max error " << quantizationError.maxPositionError << " in position (bound "
+		       << snorm16MaxError << "), " << quantizationError.maxColorError << " in color (bound " << unorm8MaxError << ")." << std::endl;
+		if( quantizationError.clampedValues ) logger << "WARNING: " << quantizationError.clampedValues << " vertex value(s) were out of the quantized range and clamped." << std::endl;
+	}
+
+	const uint32_t vertexCount = mesh.empty() ? static_cast<uint32_t>( triangle.size() ) : static_cast<uint32_t>( mesh.getHeader().vertexCount );
+	const uint32_t indexCount = mesh.empty() ? 0 : static_cast<uint32_t>( mesh.getHeader().indexCount );
+	const VkIndexType indexType = !mesh.empty() && mesh.getHeader().indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	const bool streamTriangle = ::streamVertexData && mesh.empty();
+	if( ::streamVertexData && !streamTriangle ) logger << "WARNING: streamVertexData only streams the built-in triangle; the mesh is drawn from the static vertex buffer." << std::endl;
+
+	const uint32_t instanceCount = getInstanceCount();
+	const bool instanced = instanceCount > 0;
+	if( instanced ) logger << "INFO: Drawing " << instanceCount << " instance(s) per frame." << std::endl;
+
 	const auto supportedLayers = enumerate<VkInstance, VkLayerProperties>();
 	vector<const char*> requestedLayers;
 
@@ -267,11 +573,29 @@ int helloTriangle() try{
 
 
 	const auto supportedInstanceExtensions = getSupportedInstanceExtensions( requestedLayers );
+#ifdef USE_PLATFORM_NONE
+	vector<const char*> requestedInstanceExtensions; // offscreen; no VK_KHR_surface
+#else
 	const auto platformSurfaceExtension = getPlatformSurfaceExtensionName();
 	vector<const char*> requestedInstanceExtensions = {
 		VK_KHR_SURFACE_EXTENSION_NAME,
 		platformSurfaceExtension.c_str()
 	};
+#endif
+
+	// optional; needed to query the features of newer device extensions
+	const bool pdProps2Supported = isExtensionSupported( VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, supportedInstanceExtensions );
+	if( pdProps2Supported ) requestedInstanceExtensions.push_back( VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME );
+
+#ifndef USE_PLATFORM_NONE
+	// optional; VK_EXT_swapchain_maintenance1 (fences signaled by presents) depends on these
+	const bool surfaceMaintenance1Supported = isExtensionSupported( VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME, supportedInstanceExtensions )
+		&& isExtensionSupported( VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME, supportedInstanceExtensions );
+	if( surfaceMaintenance1Supported ){
+		requestedInstanceExtensions.push_back( VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME );
+		requestedInstanceExtensions.push_back( VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME );
+	}
+#endif
 
 #if VULKAN_VALIDATION
 	DebugObjectType debugExtensionTag;
@@ -323,7 +647,11 @@ int helloTriangle() try{
 
 
 	const PlatformWindow window = initWindow( ::appName, ::initialWindowWidth, ::initialWindowHeight );
+#ifdef USE_PLATFORM_NONE
+	const VkSurfaceKHR surface = VK_NULL_HANDLE; // rendering into offscreen images instead
+#else
 	const VkSurfaceKHR surface = initSurface( instance, window );
+#endif
 
 	const VkPhysicalDevice physicalDevice = getPhysicalDevice( instance, surface );
 	const VkPhysicalDeviceProperties physicalDeviceProperties = getPhysicalDeviceProperties( physicalDevice );
@@ -331,20 +659,100 @@ int helloTriangle() try{
 
 	uint32_t graphicsQueueFamily, presentQueueFamily;
 	std::tie( graphicsQueueFamily, presentQueueFamily ) = getQueueFamilies( physicalDevice, surface );
+	const uint32_t transferQueueFamily = getTransferQueueFamily( physicalDevice, graphicsQueueFamily );
+	if( transferQueueFamily != graphicsQueueFamily ) logger << "INFO: Uploading through the dedicated transfer queue family " << transferQueueFamily << "." << std::endl;
+
+	const VkPhysicalDeviceFeatures supportedFeatures = getPhysicalDeviceFeatures( physicalDevice );
+	const bool statisticsQueries = ::pipelineStatistics && benchmarking && supportedFeatures.pipelineStatisticsQuery;
+	if( ::pipelineStatistics && benchmarking && !statisticsQueries ) logger << "WARNING: pipelineStatisticsQuery feature is not supported; pipeline statistics will not be measured." << std::endl;
+
+	VkPhysicalDeviceFeatures features = {}; // don't need any special feature for this demo
+	features.pipelineStatisticsQuery = statisticsQueries; // except for optional instrumentation
+	vector<const char*> deviceExtensions;
+	if( surface ) deviceExtensions.push_back( VK_KHR_SWAPCHAIN_EXTENSION_NAME );
+
+	const bool timelinePacing = ::useTimelineSemaphore && pdProps2Supported && isTimelineSemaphoreSupported( physicalDevice, requestedLayers );
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+		nullptr, // pNext
+		VK_TRUE // timelineSemaphore
+	};
+	if( timelinePacing ) deviceExtensions.push_back( VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME );
+	const void* featuresChain = timelinePacing ? &timelineFeatures : nullptr;
+
+#ifndef USE_PLATFORM_NONE
+	// retired swapchains are killed once the fences of their presents are signaled; see recreateSwapchain
+	const bool presentFenceSupport = pdProps2Supported && surfaceMaintenance1Supported && isSwapchainMaintenance1Supported( physicalDevice, requestedLayers );
+	VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenance1Features{
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT,
+		timelinePacing ? &timelineFeatures : nullptr, // pNext
+		VK_TRUE // swapchainMaintenance1
+	};
+	if( presentFenceSupport ){
+		deviceExtensions.push_back( VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME );
+		featuresChain = &swapchainMaintenance1Features;
+	}
+#endif
 
-	const VkPhysicalDeviceFeatures features = {}; // don't need any special feature for this demo
-	const vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	const auto supportedDeviceExtensions = getSupportedDeviceExtensions( physicalDevice, requestedLayers );
+	const bool dedicatedAllocation = ::useDedicatedAllocation
+		&& isExtensionSupported( VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, supportedDeviceExtensions )
+		&& isExtensionSupported( VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME, supportedDeviceExtensions );
+	if( dedicatedAllocation ){
+		deviceExtensions.push_back( VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME );
+		deviceExtensions.push_back( VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME );
+	}
 
-	const VkDevice device = initDevice( physicalDevice, features, graphicsQueueFamily, presentQueueFamily, requestedLayers, deviceExtensions );
+	const bool memoryBudgetSupported = pdProps2Supported && isExtensionSupported( VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, supportedDeviceExtensions );
+	if( memoryBudgetSupported ) deviceExtensions.push_back( VK_EXT_MEMORY_BUDGET_EXTENSION_NAME );
+	else logger << "INFO: VK_EXT_memory_budget is not supported; memory budgets are estimated from the heap sizes." << std::endl;
+
+	// the compute pre-pass runs on the graphics queue
+	// more than one draw command per draw (each with its own first instance) needs the multiDrawIndirect features; a single command covers all instances otherwise
+	const bool gpuDriven = ::gpuDrivenDraws && (getQueueFamilyProperties( physicalDevice )[graphicsQueueFamily].queueFlags & VK_QUEUE_COMPUTE_BIT);
+	if( ::gpuDrivenDraws && !gpuDriven ) logger << "WARNING: The graphics queue family does not support compute; draw commands are recorded on the CPU." << std::endl;
+	const bool multiDrawIndirect = gpuDriven && supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+	features.multiDrawIndirect = multiDrawIndirect;
+	features.drawIndirectFirstInstance = multiDrawIndirect;
+	const bool drawIndirectCount = multiDrawIndirect && isExtensionSupported( VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME, supportedDeviceExtensions );
+	if( drawIndirectCount ) deviceExtensions.push_back( VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME );
+	// the culling pass reads all the instances through a single storage buffer descriptor
+	const bool instancesFitStorage = VkDeviceSize( sizeof( Instance2D_ColorU8 ) ) * instanceCount <= physicalDeviceProperties.limits.maxStorageBufferRange;
+	const bool culling = gpuDriven && instanced && ::gpuCulling && instancesFitStorage;
+	if( gpuDriven && instanced && ::gpuCulling && !culling ) logger << "WARNING: The instances exceed maxStorageBufferRange; GPU culling is disabled." << std::endl;
+	logger << "INFO: Frames are paced with " << (timelinePacing ? "a timeline semaphore" : "fences") << "." << std::endl;
+
+	const VkDevice device = initDevice(
+		physicalDevice, features, graphicsQueueFamily, presentQueueFamily, transferQueueFamily, requestedLayers, deviceExtensions,
+		featuresChain
+	);
 	const VkQueue graphicsQueue = getQueue( device, graphicsQueueFamily, 0 );
+	const VkQueue transferQueue = getQueue( device, transferQueueFamily, 0 );
+#ifndef USE_PLATFORM_NONE
 	const VkQueue presentQueue = getQueue( device, presentQueueFamily, 0 );
+#endif
 
 
+#ifdef USE_PLATFORM_NONE
+	// left in transfer layout, so the result could be copied out
+	VkRenderPass renderPass = initRenderPass( device, ::offscreenFormat, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL );
+#else
 	VkSurfaceFormatKHR surfaceFormat = getSurfaceFormat( physicalDevice, surface );
-	VkRenderPass renderPass = initRenderPass( device, surfaceFormat );
+	VkRenderPass renderPass = initRenderPass( device, surfaceFormat.format );
+#endif
 
-	vector<uint32_t> vertexShaderBinary = {
+	const vector<uint32_t> simpleVertexShaderBinary = {
 #include "shaders/hello_triangle.vert.spv.inl"
+	};
+	const vector<uint32_t> instancedVertexShaderBinary = {
+#include "shaders/hello_triangle_instanced.vert.spv.inl"
+	};
+	const vector<uint32_t>& vertexShaderBinary = instanced ? instancedVertexShaderBinary : simpleVertexShaderBinary;
+	const vector<uint32_t> drawCommandsShaderBinary = {
+#include "shaders/hello_triangle_draws.comp.spv.inl"
+	};
+	const vector<uint32_t> cullShaderBinary = {
+#include "shaders/hello_triangle_cull.comp.spv.inl"
 	};
 	vector<uint32_t> fragmentShaderBinary = {
 #include "shaders/hello_triangle.frag.spv.inl"
@@ -353,221 +761,892 @@ int helloTriangle() try{
 	VkShaderModule fragmentShader = initShaderModule( device, fragmentShaderBinary );
 	VkPipelineLayout pipelineLayout = initPipelineLayout( device );
 
-	VkBuffer vertexBuffer = initBuffer( device, sizeof( decltype( triangle )::value_type ) * triangle.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT );
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	bool pipelineCacheWarm = false;
+	if( usePipelineCache ) std::tie( pipelineCache, pipelineCacheWarm ) = loadPipelineCache( device, physicalDeviceProperties, pipelineCacheFilename );
+
+	// created once; survives all swapchain recreations
+	const auto pipelineBegin = Clock::now();
+	VkPipeline pipeline = initPipeline(
+		device,
+		pipelineCache,
+		physicalDeviceProperties.limits,
+		pipelineLayout,
+		renderPass,
+		vertexShader,
+		fragmentShader,
+		vertexBufferBinding,
+		vertexLayout,
+		instanced,
+		instanceBufferBinding
+	);
+	logger << "INFO: Graphics pipeline created in " << toMilliseconds( Clock::now() - pipelineBegin ) << " ms ("
+	       << (pipelineCache ? (pipelineCacheWarm ? "warm" : "cold") : "no") << " pipeline cache)." << std::endl;
+
+	// all resources are sub-allocated from big memory blocks
+	DeviceMemoryAllocator memoryAllocator( device, physicalDeviceMemoryProperties, physicalDeviceProperties.limits, ::memoryBlockSize, dedicatedAllocation );
+	MemoryTelemetry memoryTelemetry( physicalDevice, physicalDeviceMemoryProperties, memoryBudgetSupported, ::memoryBudgetWarningRatio );
+
+	// copies host data into memory that might not be host visible; the graphics queue waits for each upload batch
+	// the culling pass reads the instances in a compute shader, before any vertex input
+	const VkPipelineStageFlags uploadConsumerStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | (culling ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : 0);
+	StagingUploader uploader( device, memoryAllocator, transferQueueFamily, transferQueue, graphicsQueue, uploadConsumerStages, ::stagingBufferSize );
+
+	VkBuffer vertexBuffer = initBuffer(
+		device,
+		VkDeviceSize( vertexStride ) * vertexCount,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		{graphicsQueueFamily, transferQueueFamily}
+	);
 	const std::vector<VkMemoryPropertyFlags> memoryTypePriority{
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // preferably wanna device-side memory that can be updated from host without hassle
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT // guaranteed to allways be supported
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // fastest for the GPU, even if not host visible (no BAR)
+		0 // any
 	};
-	VkDeviceMemory vertexBufferMemory = initMemory<ResourceType::Buffer>(
+	MemoryAllocation vertexBufferMemory = initMemory<ResourceType::Buffer>(
 		device,
-		physicalDeviceMemoryProperties,
+		memoryAllocator,
 		vertexBuffer,
 		memoryTypePriority
 	);
-	setVertexData( device, vertexBufferMemory, triangle ); // Writes throug memory map. Synchronization is implicit for any subsequent vkQueueSubmit batches.
 
-	VkCommandPool commandPool = initCommandPool( device, graphicsQueueFamily );
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation indexBufferMemory{};
+	if( indexCount ){
+		indexBuffer = initBuffer(
+			device,
+			VkDeviceSize( mesh.getHeader().indexSize ) * indexCount,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			{graphicsQueueFamily, transferQueueFamily}
+		);
+		indexBufferMemory = initMemory<ResourceType::Buffer>( device, memoryAllocator, indexBuffer, memoryTypePriority );
+	}
+
+	VkBuffer instanceBuffer = VK_NULL_HANDLE;
+	MemoryAllocation instanceBufferMemory{};
+	if( instanced ){
+		instanceBuffer = initBuffer(
+			device,
+			VkDeviceSize( sizeof( Instance2D_ColorU8 ) ) * instanceCount,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | (culling ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0),
+			{graphicsQueueFamily, transferQueueFamily}
+		);
+		instanceBufferMemory = initMemory<ResourceType::Buffer>( device, memoryAllocator, instanceBuffer, memoryTypePriority );
+	}
+
+	if( meshOptimized ){
+		uploader.upload( vertexBuffer, 0 /*offset*/, optimizedMesh.vertices.data(), optimizedMesh.vertices.size() );
+		uploader.upload( indexBuffer, 0 /*offset*/, optimizedMesh.indices.data(), optimizedMesh.indices.size() );
+		// already copied into the staging memory
+		vector<unsigned char>().swap( optimizedMesh.vertices );
+		vector<unsigned char>().swap( optimizedMesh.indices );
+	}
+	else if( !mesh.empty() ) setMeshData( uploader, mesh, vertexBuffer, indexBuffer );
+	else if( useQuantizedVertices ) setVertexData( uploader, vertexBuffer, quantizedTriangle );
+	else setVertexData( uploader, vertexBuffer, triangle );
+	if( instanced ) setVertexData(  uploader, instanceBuffer, generateInstanceGrid( instanceCount, mesh.empty() ? triangleSize : 2.0f /*assume the mesh fills the clip space*/ )  );
+	uploader.flush(); // anything submitted to the graphics queue from now on sees the vertex data
+
+	// ring of per-frame contexts; the frame being recorded uses the slot the GPU finished the longest time ago
+	const uint32_t frameCount = getFramesInFlight();
+	logger << "INFO: Using " << frameCount << " frame(s) in flight." << std::endl;
+	vector<FrameContext> frames = initFrameContexts( device, graphicsQueueFamily, frameCount, !timelinePacing );
+	uint32_t frameIndex = 0; // index of the current frame context modulo frameCount
+
+	// persistently mapped ring for the data written every frame; a region per frame context
+	VkBuffer streamingBuffer = initBuffer(
+		device,
+		::streamingRegionSize * frameCount,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+	);
+	const std::vector<VkMemoryPropertyFlags> streamingMemoryTypePriority{
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // BAR memory if any; GPU reads it without crossing the bus
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT // guaranteed to allways be supported
+	};
+	MemoryAllocation streamingBufferMemory = initMemory<ResourceType::Buffer>( device, memoryAllocator, streamingBuffer, streamingMemoryTypePriority );
+	StreamingBuffer streaming( streamingBuffer, memoryAllocator.map( streamingBufferMemory ), ::streamingRegionSize, frameCount, physicalDeviceProperties.limits );
+
+	// GPU-generated draw commands; a region per frame context, written by the compute pre-pass of the frame
+	const uint64_t drawnInstances = instanced ? instanceCount : 1;
+	const uint64_t maxDrawCommands = multiDrawIndirect ? std::max( physicalDeviceProperties.limits.maxDrawIndirectCount, 1u ) : 1;
+	const uint32_t instancesPerCommand = static_cast<uint32_t>(  multiDrawIndirect ? std::max<uint64_t>( ::instancesPerDrawCommand, (drawnInstances + maxDrawCommands - 1) / maxDrawCommands ) : drawnInstances  );
+	const DrawCommandParameters drawCommandParameters{
+		static_cast<uint32_t>( (drawnInstances + instancesPerCommand - 1) / instancesPerCommand ), // commandCount
+		static_cast<uint32_t>( drawnInstances ),
+		instancesPerCommand,
+		indexBuffer ? indexCount : vertexCount,
+		indexBuffer ? 1u : 0u,
+		culling ? 1u : 0u
+	};
+	const uint32_t drawCommandStride = indexBuffer ? sizeof( VkDrawIndexedIndirectCommand ) : sizeof( VkDrawIndirectCommand );
+	const VkDeviceSize storageAlignment = std::max<VkDeviceSize>( physicalDeviceProperties.limits.minStorageBufferOffsetAlignment, 4 );
+	const auto alignStorage = [storageAlignment]( const VkDeviceSize size ){ return (size + storageAlignment - 1) / storageAlignment * storageAlignment; };
+	const VkDeviceSize drawCommandRegionSize = alignStorage( drawCountSize + VkDeviceSize( drawCommandStride ) * drawCommandParameters.commandCount );
+
+	// the instances surviving the culling pass, compacted; a region per frame context, drawn instead of the instance buffer
+	const VkDeviceSize survivorRegionSize = alignStorage( VkDeviceSize( sizeof( Instance2D_ColorU8 ) ) * instanceCount );
+	const uint32_t maxWorkgroupCountX = physicalDeviceProperties.limits.maxComputeWorkGroupCount[0]; // at least 65535
+	CullParameters cullParameters{ {-1.0f, -1.0f}, {1.0f, 1.0f}, {}, instanceCount, 0 }; // viewportSize set each frame; the mesh is assumed to fill the clip space
+	if( mesh.empty() ){
+		for( int i = 0; i < 2; ++i ){
+			cullParameters.modelMin[i] = cullParameters.modelMax[i] = triangle[0].position.position[i];
+			for( const auto& v : triangle ){
+				cullParameters.modelMin[i] = std::min( cullParameters.modelMin[i], v.position.position[i] );
+				cullParameters.modelMax[i] = std::max( cullParameters.modelMax[i], v.position.position[i] );
+			}
+		}
+	}
+
+	VkBuffer drawCommandBuffer = VK_NULL_HANDLE;
+	MemoryAllocation drawCommandBufferMemory{};
+	VkDescriptorSetLayout drawCommandSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet drawCommandSet = VK_NULL_HANDLE;
+	VkPipelineLayout drawCommandPipelineLayout = VK_NULL_HANDLE;
+	VkShaderModule drawCommandShader = VK_NULL_HANDLE;
+	VkPipeline drawCommandPipeline = VK_NULL_HANDLE;
+	VkBuffer survivorBuffer = VK_NULL_HANDLE;
+	MemoryAllocation survivorBufferMemory{};
+	VkBuffer cullStatisticsBuffer = VK_NULL_HANDLE; // surviving instance count per frame context, read back by the host
+	MemoryAllocation cullStatisticsBufferMemory{};
+	const uint32_t* cullStatistics = nullptr;
+	VkShaderModule cullShader = VK_NULL_HANDLE;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+	if( gpuDriven ){
+		drawCommandBuffer = initBuffer( device, drawCommandRegionSize * frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT );
+		drawCommandBufferMemory = initMemory<ResourceType::Buffer>( device, memoryAllocator, drawCommandBuffer, memoryTypePriority );
+
+		// the frame's regions are picked by the dynamic offsets
+		vector<VkDescriptorType> bindingTypes = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC }; // draw commands
+		if( culling ){
+			bindingTypes.push_back( VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ); // all instances
+			bindingTypes.push_back( VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC ); // survivors
+		}
+		drawCommandSetLayout = initDescriptorSetLayout( device, bindingTypes, VK_SHADER_STAGE_COMPUTE_BIT );
+		descriptorPool = initDescriptorPool( device, bindingTypes, 1 );
+		drawCommandSet = allocateDescriptorSet( device, descriptorPool, drawCommandSetLayout );
+		writeBufferDescriptor( device, drawCommandSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, drawCommandBuffer, 0, drawCommandRegionSize );
+
+		// both shaders declare their push constants from offset 0
+		const uint32_t pushConstantsSize = static_cast<uint32_t>(  std::max( sizeof( DrawCommandParameters ), sizeof( CullParameters ) )  );
+		drawCommandPipelineLayout = initPipelineLayout( device, drawCommandSetLayout, VK_SHADER_STAGE_COMPUTE_BIT, pushConstantsSize );
+		drawCommandShader = initShaderModule( device, drawCommandsShaderBinary );
+		drawCommandPipeline = initComputePipeline( device, pipelineCache, drawCommandPipelineLayout, drawCommandShader );
+
+		if( culling ){
+			survivorBuffer = initBuffer( device, survivorRegionSize * frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT );
+			survivorBufferMemory = initMemory<ResourceType::Buffer>( device, memoryAllocator, survivorBuffer, memoryTypePriority );
+			writeBufferDescriptor( device, drawCommandSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, instanceBuffer, 0, VK_WHOLE_SIZE );
+			writeBufferDescriptor( device, drawCommandSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, survivorBuffer, 0, survivorRegionSize );
+
+			cullStatisticsBuffer = initBuffer( device, sizeof( uint32_t ) * frameCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT );
+			const std::vector<VkMemoryPropertyFlags> readbackMemoryTypePriority{
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, // the CPU reads it
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			};
+			cullStatisticsBufferMemory = initMemory<ResourceType::Buffer>( device, memoryAllocator, cullStatisticsBuffer, readbackMemoryTypePriority );
+			cullStatistics = static_cast<const uint32_t*>( memoryAllocator.map( cullStatisticsBufferMemory ) );
+
+			cullShader = initShaderModule( device, cullShaderBinary );
+			cullPipeline = initComputePipeline( device, pipelineCache, drawCommandPipelineLayout, cullShader );
+		}
+
+		logger << "INFO: " << drawCommandParameters.commandCount << " draw command(s) generated on the GPU per frame, drawn with "
+		       << (drawIndirectCount ? "vkCmdDrawIndirectCountKHR" : "vkCmdDrawIndirect") << (culling ? ", of the instances surviving GPU culling" : "") << "." << std::endl;
+	}
+
+	// GPU progress counter; incremented by each frame submission
+	// anything needing to know whether the GPU is past some frame can wait on (or poll) this
+	const VkSemaphore frameTimeline = timelinePacing ? initTimelineSemaphore( device ) : VK_NULL_HANDLE;
+	uint64_t lastSubmittedSerial = 0; // serial number of the last frame submission (same as its timeline value)
+
+	// GPU timer; a begin and an end timestamp per frame context, written only in the measured frames
+	const uint32_t timestampValidBits = getQueueFamilyProperties( physicalDevice )[graphicsQueueFamily].timestampValidBits;
+	if( ::gpuTimestamps && benchmarking && !timestampValidBits ) logger << "WARNING: The graphics queue does not support timestamps; GPU frame time will not be measured." << std::endl;
+	const VkQueryPool timestampPool = ::gpuTimestamps && benchmarking && timestampValidBits ? initQueryPool( device, VK_QUERY_TYPE_TIMESTAMP, 2 * frameCount ) : VK_NULL_HANDLE;
+	const uint64_t timestampMask = timestampValidBits >= 64 ? ~uint64_t( 0 ) : (uint64_t( 1 ) << timestampValidBits) - 1;
+
+	// pipeline statistics of the draw; one query per frame context, written only in the measured frames
+	// results come in the order of the flag bits
+	const VkQueryPipelineStatisticFlags statisticsFlags =
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+	;
+	const char* const statisticsNames[] = { "vertexShaderInvocations", "clippingPrimitives", "fragmentShaderInvocations" };
+	const uint32_t statisticsCount = sizeof( statisticsNames ) / sizeof( statisticsNames[0] );
+	const VkQueryPool statisticsPool = statisticsQueries ? initQueryPool( device, VK_QUERY_TYPE_PIPELINE_STATISTICS, frameCount, statisticsFlags ) : VK_NULL_HANDLE;
+
+	// serial of the newest submission such that it and all before it are finished
+	const auto getCompletedSerial = [&]() -> uint64_t{
+		if( frameTimeline ) return getTimelineSemaphoreValue( device, frameTimeline );
+
+		// every submission not tracked by a slot fence was already waited on
+		uint64_t completedSerial = lastSubmittedSerial;
+		for( const auto& f : frames ){
+			const VkResult status = vkGetFenceStatus( device, f.fence );
+			if( status == VK_NOT_READY ) completedSerial = std::min( completedSerial, f.submissionSerial - 1 );
+			else{ RESULT_HANDLER( status, "vkGetFenceStatus" ); }
+		}
+		return completedSerial;
+	};
+
+	// objects retired by swapchain recreation, waiting for the GPU to finish with them
+	Graveyard graveyard;
 
 	// might need synchronization if init is more advanced than this
 	//VkResult errorCode = vkDeviceWaitIdle( device ); RESULT_HANDLER( errorCode, "vkDeviceWaitIdle" );
 
+	bool firstFrameDone = false;
 
-	// place-holder swapchain dependent objects
-	VkSwapchainKHR swapchain = VK_NULL_HANDLE; // has to be NULL -- signifies that there's no swapchain
-	vector<VkImageView> swapchainImageViews;
-	vector<VkFramebuffer> framebuffers;
+	// benchmark measurements; samples are taken only from the measured frames
+	FrameStatistics frameStatistics;
+	bool measuringFrame = false; // whether the frame being rendered is one of the measured
+	bool benchmarkDone = false;
+	Clock::time_point lastFrameEnd;
 
-	VkPipeline pipeline = VK_NULL_HANDLE; // has to be NULL for the case the app ends before even first swapchain
-	vector<VkCommandBuffer> commandBuffers;
+	// before the first frame, so the rendering does not compete for the bus
+	if( benchmarking && ::benchmarkHostUploads ) measureHostUploadBandwidth( device, memoryAllocator, frameStatistics );
 
-	vector<VkSemaphore> imageReadySs;
-	vector<VkSemaphore> renderDoneSs;
+	const auto addFrameSample = [&]( const char* name, const Clock::duration duration ){
+		if( measuringFrame ) frameStatistics.addSample( name, toMilliseconds( duration ) );
+	};
 
-	// workaround for validation layer "memory leak" + might also help the driver to cleanup old resources
-	// this should not be needed for a real-word app, because they are likely to use fences naturaly (e.g. responding to user input )
-	// read https://github.com/KhronosGroup/Vulkan-LoaderAndValidationLayers/issues/1628
-	const uint32_t maxInflightSubmissions = 2; // more than 2 probably does not make much sense
-	uint32_t submissionNr = 0; // index of the current submission modulo maxInflightSubmission
-	vector<VkFence> submissionFences;
+	// reads back the GPU queries of the measured frame that used the slot last
+	// only called once the slot's submission is finished, so it never stalls
+	const auto collectFrameQueries = [&]( FrameContext& frame, const uint32_t slot ){
+		if( !frame.queriesPending ) return;
+		frame.queriesPending = false;
+
+		uint64_t timestamps[2];
+		if(  timestampPool && getQueryResults( device, timestampPool, 2 * slot, 2, timestamps )  ){
+			const uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask; // survives wrap-around
+			const double nanoseconds = static_cast<double>( ticks ) * physicalDeviceProperties.limits.timestampPeriod;
+			frameStatistics.addSample( "gpuFrameTime", nanoseconds / 1e6 );
+		}
 
+		uint64_t statistics[statisticsCount];
+		if(  statisticsPool && getQueryResults( device, statisticsPool, slot, 1, statistics, statisticsCount )  ){
+			for( uint32_t i = 0; i < statisticsCount; ++i ) frameStatistics.addSample( statisticsNames[i], static_cast<double>( statistics[i] ), "count" );
+		}
 
-	const std::function<bool(void)> recreateSwapchain = [&](){
-		// swapchain recreation -- will be done before the first frame too;
-		TODO( "This may be triggered from many sources (e.g. WM_SIZE event, and VK_ERROR_OUT_OF_DATE_KHR too). Should prevent duplicate swapchain recreation." )
+		if( cullStatistics ){
+			frameStatistics.addSample( "survivingInstances", cullStatistics[slot], "count" );
+			frameStatistics.addSample( "culledInstances", instanceCount - cullStatistics[slot], "count" );
+		}
+	};
 
-		const VkSwapchainKHR oldSwapchain = swapchain;
-		swapchain = VK_NULL_HANDLE;
+	// called at the beginning of each render(), before anything else
+	const auto beginFrameMeasurement = [&](){
+		const uint64_t frameNumber = lastSubmittedSerial; // zero-based number of the frame about to be rendered
+		measuringFrame = benchmarking && !benchmarkDone && frameNumber >= benchmark.warmupFrames;
+	};
+
+	// usage is in the report as a per-frame series, so its changes over the measured frames show
+	const auto sampleMemoryTelemetry = [&](){
+		memoryTelemetry.sample( memoryAllocator );
+		if( !measuringFrame ) return;
+
+		const auto& heaps = memoryTelemetry.getHeaps();
+		for( uint32_t heap = 0; heap < heaps.size(); ++heap ){
+			if( !heaps[heap].usage ) continue;
+			frameStatistics.addSample( "memoryHeap" + to_string( heap ) + "Usage", static_cast<double>( heaps[heap].usage ) / (1024.0 * 1024.0), "MiB" );
+		}
+	};
+
+	// called once the frame is submitted (and presented)
+	const auto endFrameMeasurement = [&]( const Clock::time_point frameBegin ){
+		const auto now = Clock::now();
+		addFrameSample( "cpuFrameTime", now - frameBegin ); // includes the time blocked in Vulkan
+		if( lastFrameEnd != Clock::time_point() ) addFrameSample( "frameInterval", now - lastFrameEnd );
+		lastFrameEnd = now;
+
+		if( ::memoryTelemetryPeriod && lastSubmittedSerial % ::memoryTelemetryPeriod == 0 ) sampleMemoryTelemetry();
+
+		if( benchmarking && !benchmarkDone && lastSubmittedSerial >= benchmark.warmupFrames + benchmark.measuredFrames ){
+			benchmarkDone = true;
+			requestQuit( window );
+		}
+	};
+
+	const auto reportMemoryStats = [&](){
+		const auto heapStats = memoryAllocator.getHeapStats();
+		for( uint32_t heap = 0; heap < heapStats.size(); ++heap ){
+			const MemoryHeapStats& hs = heapStats[heap];
+			if( !hs.blockCount ) continue;
+
+			logger << "INFO: Memory heap " << heap << ": " << hs.allocationCount << " resource(s) in " << hs.blockCount << " block(s); "
+			       << hs.usedBytes << " of " << hs.allocatedBytes << " B used; fragmentation " << 100.0 * hs.fragmentation << " %." << std::endl;
+
+			const string prefix = "memoryHeap" + to_string( heap );
+			frameStatistics.setCounter( prefix + "Blocks", hs.blockCount );
+			frameStatistics.setCounter( prefix + "AllocatedBytes", hs.allocatedBytes );
+			frameStatistics.setCounter( prefix + "UsedBytes", hs.usedBytes );
+		}
+
+		memoryTelemetry.sample( memoryAllocator );
+		const auto& heaps = memoryTelemetry.getHeaps();
+		for( uint32_t heap = 0; heap < heaps.size(); ++heap ){
+			const HeapTelemetry& h = heaps[heap];
+			if( !h.peakUsage ) continue;
+
+			logger << "INFO: Memory heap " << heap << ": peak usage " << h.peakUsage << " B of " << h.budget << " B budget"
+			       << (memoryTelemetry.isBudgetSupported() ? "" : " (estimated)") << "; heap size " << h.size << " B." << std::endl;
+
+			const string prefix = "memoryHeap" + to_string( heap );
+			frameStatistics.setCounter( prefix + "Budget", h.budget );
+			frameStatistics.setCounter( prefix + "PeakUsage", h.peakUsage );
+		}
+
+		const auto& memoryTypes = memoryTelemetry.getMemoryTypes();
+		for( uint32_t memoryType = 0; memoryType < memoryTypes.size(); ++memoryType ){
+			if( !memoryTypes[memoryType].blockCount ) continue;
+
+			const string prefix = "memoryType" + to_string( memoryType );
+			frameStatistics.setCounter( prefix + "AllocatedBytes", memoryTypes[memoryType].allocatedBytes );
+			frameStatistics.setCounter( prefix + "UsedBytes", memoryTypes[memoryType].usedBytes );
+		}
+		frameStatistics.setProperty( "memoryBudget", memoryTelemetry.isBudgetSupported() ? "VK_EXT_memory_budget" : "estimated" );
+	};
+
+	const auto writeBenchmarkReport = [&](){
+		if( !benchmarking ) return;
+
+		// the last measured frames might still be in flight
+		if( timestampPool || statisticsPool || cullStatistics ){
+			VkResult errorCode = vkDeviceWaitIdle( device ); RESULT_HANDLER( errorCode, "vkDeviceWaitIdle" );
+			for( uint32_t i = 0; i < frameCount; ++i ) collectFrameQueries( frames[i], i );
+		}
+
+		const uint64_t measuredFrames = frameStatistics.sampleCount( "cpuFrameTime" );
+		if( measuredFrames < benchmark.measuredFrames ){
+			logger << "WARNING: Benchmark ended early; only " << measuredFrames << " of " << benchmark.measuredFrames << " frame(s) were measured." << std::endl;
+		}
+
+		frameStatistics.setProperty( "device", physicalDeviceProperties.deviceName );
+		frameStatistics.setProperty( "framePacing", frameTimeline ? "timelineSemaphore" : "fences" );
+		if( timestampPool ) frameStatistics.setProperty( "timestampPeriod", std::to_string( physicalDeviceProperties.limits.timestampPeriod ) + " ns" );
+		if( meshOptimized ){
+			frameStatistics.setMetric( "meshAcmrBefore", optimizedMesh.before.acmr );
+			frameStatistics.setMetric( "meshAcmrAfter", optimizedMesh.after.acmr );
+			frameStatistics.setMetric( "meshAtvrBefore", optimizedMesh.before.atvr );
+			frameStatistics.setMetric( "meshAtvrAfter", optimizedMesh.after.atvr );
+		}
+		frameStatistics.setCounter( "framesInFlight", frameCount );
+		frameStatistics.setCounter( "warmupFrames", benchmark.warmupFrames );
+		frameStatistics.setCounter( "measuredFrames", measuredFrames );
+
+		if( benchmark.reportFilename.empty() ){
+			logger << "INFO: Benchmark report:" << std::endl;
+			frameStatistics.writeJson( logger );
+			return;
+		}
+
+		std::ofstream report( benchmark.reportFilename );
+		frameStatistics.writeJson( report );
+		report.close();
+		if( report ) logger << "INFO: Benchmark report written to " << benchmark.reportFilename << "." << std::endl;
+		else logger << "WARNING: Failed to write benchmark report to " << benchmark.reportFilename << "." << std::endl;
+	};
+
+	// waits until the GPU is done with everything the frame context owns, and readies it for recording
+	const auto beginFrame = [&]( FrameContext& frame ){
+		// remove oldest frame from being in flight before starting new one
+		// refer to doc/, which talks about the cycle of how the synch primitives are (re)used here
+		const auto waitBegin = Clock::now();
+		if( frameTimeline ){
+			waitTimelineSemaphore( device, frameTimeline, frame.submissionSerial );
+			addFrameSample( "vkWaitSemaphores", Clock::now() - waitBegin );
+		}
+		else{
+			VkResult errorCode = vkWaitForFences( device, 1, &frame.fence, VK_TRUE, UINT64_MAX ); RESULT_HANDLER( errorCode, "vkWaitForFences" );
+			addFrameSample( "vkWaitForFences", Clock::now() - waitBegin );
+		}
+
+		// GPU is done with everything this slot owns
+		frame.scratch.reset();
+		streaming.beginRegion( frameIndex );
+		{VkResult errorCode = vkResetCommandPool( device, frame.commandPool, 0 ); RESULT_HANDLER( errorCode, "vkResetCommandPool" );}
+		collectFrameQueries( frame, frameIndex );
+
+		// kill what was retired earlier (e.g. by swapchain recreation), if the GPU is done with it
+		if( !graveyard.empty() ) graveyard.collect( getCompletedSerial() );
+	};
+
+	// copies the vertices into this frame's region of the streaming buffer
+	const auto streamVertices = [&]( const auto& vertices ) -> StreamingSlice{
+		using Vertex = typename std::decay<decltype( vertices )>::type::value_type;
+		const StreamingSlice slice = streaming.allocateVertices<Vertex>( vertices.size() );
+		std::copy( vertices.begin(), vertices.end(), static_cast<Vertex*>( slice.data ) );
+		return slice;
+	};
+
+	const auto recordFrame = [&]( FrameContext& frame, VkFramebuffer framebuffer, const VkExtent2D extent ){
+		const bool timed = measuringFrame && timestampPool;
+		const bool counted = measuringFrame && statisticsPool;
+
+		beginCommandBuffer( frame.commandBuffer );
+			// queries have to be reset outside of a render pass
+			if( counted ) recordResetQueries( frame.commandBuffer, statisticsPool, frameIndex, 1 );
+			if( timed ){
+				recordResetQueries( frame.commandBuffer, timestampPool, 2 * frameIndex, 2 );
+				recordWriteTimestamp( frame.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, 2 * frameIndex );
+			}
+
+			const VkDeviceSize drawCommandRegion = frameIndex * drawCommandRegionSize;
+			const VkDeviceSize survivorRegion = frameIndex * survivorRegionSize;
+			if( drawCommandPipeline ){
+				// zero count (and survivor count), and zero records for the plain vkCmdDrawIndirect
+				recordFillBuffer( frame.commandBuffer, drawCommandBuffer, drawCommandRegion, drawCommandRegionSize, 0 );
+				recordMemoryBarrier( frame.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT );
+
+				// from the slot's scratch memory instead of a heap allocation per frame
+				uint32_t* const dynamicOffsets = frame.scratch.allocate<uint32_t>( 2 );
+				uint32_t dynamicOffsetCount = 0;
+				dynamicOffsets[dynamicOffsetCount++] = static_cast<uint32_t>( drawCommandRegion );
+				if( cullPipeline ) dynamicOffsets[dynamicOffsetCount++] = static_cast<uint32_t>( survivorRegion );
+				recordBindComputeDescriptorSet( frame.commandBuffer, drawCommandPipelineLayout, drawCommandSet, dynamicOffsetCount, dynamicOffsets );
+
+				if( cullPipeline ){
+					cullParameters.viewportSize[0] = static_cast<float>( extent.width );
+					cullParameters.viewportSize[1] = static_cast<float>( extent.height );
+					recordDispatch( frame.commandBuffer, cullPipeline, drawCommandPipelineLayout, &cullParameters, sizeof( cullParameters ), instanceCount, maxWorkgroupCountX );
+					// survivor count read, and survivors written by the next dispatch
+					recordMemoryBarrier( frame.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT );
+				}
+
+				recordDispatch( frame.commandBuffer, drawCommandPipeline, drawCommandPipelineLayout, &drawCommandParameters, sizeof( drawCommandParameters ), drawCommandParameters.commandCount, maxWorkgroupCountX );
+				recordMemoryBarrier(
+					frame.commandBuffer,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT
+				);
+
+				if( cullStatisticsBuffer ){
+					recordCopyBuffer( frame.commandBuffer, drawCommandBuffer, drawCommandRegion + survivingInstancesOffset, cullStatisticsBuffer, sizeof( uint32_t ) * frameIndex, sizeof( uint32_t ) );
+					recordMemoryBarrier( frame.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT );
+				}
+			}
+
+			recordBeginRenderPass( frame.commandBuffer, renderPass, framebuffer, ::clearColor, extent.width, extent.height );
+
+			recordBindPipeline( frame.commandBuffer, pipeline );
+			recordSetViewport( frame.commandBuffer, extent.width, extent.height );
+			if( streamTriangle ){
+				const StreamingSlice vertices = useQuantizedVertices ? streamVertices( quantizedTriangle ) : streamVertices( triangle );
+				recordBindVertexBuffer( frame.commandBuffer, vertexBufferBinding, vertices.buffer, vertices.offset );
+			}
+			else{
+				recordBindVertexBuffer( frame.commandBuffer, vertexBufferBinding, vertexBuffer );
+			}
+			if( survivorBuffer ) recordBindVertexBuffer( frame.commandBuffer, instanceBufferBinding, survivorBuffer, survivorRegion );
+			else if( instanceBuffer ) recordBindVertexBuffer( frame.commandBuffer, instanceBufferBinding, instanceBuffer );
+			if( indexBuffer ) recordBindIndexBuffer( frame.commandBuffer, indexBuffer, indexType );
+
+			if( counted ) recordBeginQuery( frame.commandBuffer, statisticsPool, frameIndex );
+			if( drawCommandPipeline ){
+				recordDrawIndirect(
+					frame.commandBuffer, drawCommandBuffer, drawCommandRegion + drawCountSize, drawCommandParameters.commandCount, drawCommandStride, indexBuffer != VK_NULL_HANDLE,
+					drawIndirectCount ? drawCommandBuffer : VK_NULL_HANDLE, drawCommandRegion
+				);
+			}
+			else if( indexBuffer ) recordDrawIndexed( frame.commandBuffer, indexCount, instanced ? instanceCount : 1 );
+			else recordDraw( frame.commandBuffer, vertexCount, instanced ? instanceCount : 1 );
+			if( counted ) recordEndQuery( frame.commandBuffer, statisticsPool, frameIndex );
+
+			recordEndRenderPass( frame.commandBuffer );
+
+			if( timed ) recordWriteTimestamp( frame.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, 2 * frameIndex + 1 );
+		endCommandBuffer( frame.commandBuffer );
+	};
+
+	// imageReadyS and renderDoneS can be NULL
+	const auto submitFrame = [&]( FrameContext& frame, VkSemaphore imageReadyS, VkSemaphore renderDoneS ){
+		// reset as late as possible, so an exception before (e.g. VK_ERROR_OUT_OF_DATE_KHR) does not leave it unsignaled forever
+		if( !frameTimeline ){
+			VkResult errorCode = vkResetFences( device, 1, &frame.fence ); RESULT_HANDLER( errorCode, "vkResetFences" );
+		}
+		submitToQueue( graphicsQueue, frame.commandBuffer, imageReadyS, renderDoneS, frame.fence, frameTimeline, lastSubmittedSerial + 1 );
+		frame.submissionSerial = ++lastSubmittedSerial;
+		frame.queriesPending = measuringFrame && (timestampPool || statisticsPool || cullStatistics);
+		frameIndex = (frameIndex + 1) % frameCount; // the slot is used up even if present fails
+	};
+
+	const auto reportStartup = [&]( const char* milestone ){
+		if( firstFrameDone ) return;
+		firstFrameDone = true;
+		logger << "INFO: Startup took " << toMilliseconds( Clock::now() - startupBegin ) << " ms (until the first frame was " << milestone << ")." << std::endl;
+	};
+
+
+#ifdef USE_PLATFORM_NONE
+	// offscreen render targets instead of swapchain images
+	// one per frame context, so frames in flight never render into the same image
+	const VkExtent2D targetExtent = { getWindowWidth( window ), getWindowHeight( window ) };
+	vector<VkImage> targetImages;
+	vector<MemoryAllocation> targetImageMemories;
+	for( uint32_t i = 0; i < frameCount; ++i ){
+		const VkImage image = initImage(
+			device, ::offscreenFormat, targetExtent.width, targetExtent.height, VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+		);
+		targetImages.push_back( image );
+		targetImageMemories.push_back(  initMemory<ResourceType::Image>( device, memoryAllocator, image, {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 /*any*/} )  );
+	}
+	vector<VkImageView> targetImageViews = initSwapchainImageViews( device, targetImages, ::offscreenFormat ); // any 2D color images do
+	vector<VkFramebuffer> framebuffers = initFramebuffers( device, renderPass, targetImageViews, targetExtent.width, targetExtent.height );
+	logger << "INFO: Rendering offscreen into " << frameCount << " " << targetExtent.width << "x" << targetExtent.height << " image(s)." << std::endl;
+
+	// no acquire and present; frames are paced only by the frame contexts
+	const std::function<void(void)> render = [&](){
+		PROFILE_ZONE( "render" );
+		const auto frameBegin = Clock::now();
+		beginFrameMeasurement();
+
+		FrameContext& frame = frames[frameIndex];
+		const VkFramebuffer framebuffer = framebuffers[frameIndex];
+
+		beginFrame( frame );
+		recordFrame( frame, framebuffer, targetExtent );
+		submitFrame( frame, VK_NULL_HANDLE, VK_NULL_HANDLE );
+
+		reportStartup( "submitted" );
+		endFrameMeasurement( frameBegin );
+	};
+
+	setPaintEventHandler( render );
+#else
+
+	// place-holder swapchain dependent objects
+	VkSwapchainKHR swapchain = VK_NULL_HANDLE; // has to be NULL -- signifies that there's no swapchain
+	VkExtent2D swapchainExtent = {};
+	vector<VkImageView> swapchainImageViews;
+	vector<VkFramebuffer> framebuffers;
 
+	// per https://github.com/KhronosGroup/Vulkan-Docs/issues/1150 need upto swapchain-image count
+	// so these are per swapchain image instead of per frame context
+	vector<VkSemaphore> renderDoneSs;
+	// VK_EXT_swapchain_maintenance1; signaled when the last present of the swapchain image is done with it and its semaphore
+	// empty if not supported
+	vector<VkFence> presentFences;
+
+	// size events (and VK_ERROR_OUT_OF_DATE_KHR) can come many times per frame, e.g. during live resize
+	// they are coalesced, so the swapchain is recreated at most once per frame
+	bool resizePending = false;
+	auto lastSizeEventTime = Clock::now();
+	uint64_t swapchainRecreations = 0;
+	uint64_t recreationsAvoided = 0;
+	Clock::duration recreationTimeTotal{ 0 };
+	Clock::duration recreationTimeMax{ 0 };
+
+
+	// capabilities with currentExtent filled in even if the surface leaves the size up to the swapchain
+	const auto getCapabilities = [&](){
 		VkSurfaceCapabilitiesKHR capabilities = getSurfaceCapabilities( physicalDevice, surface );
 
 		if( capabilities.currentExtent.width == UINT32_MAX && capabilities.currentExtent.height == UINT32_MAX ){
 			capabilities.currentExtent.width = getWindowWidth( window );
 			capabilities.currentExtent.height = getWindowHeight( window );
 		}
-		VkExtent2D surfaceSize = { capabilities.currentExtent.width, capabilities.currentExtent.height };
 
-		const bool swapchainCreatable = {
+		return capabilities;
+	};
+
+	const auto isSwapchainCreatable = []( const VkSurfaceCapabilitiesKHR& capabilities ){
+		const VkExtent2D& surfaceSize = capabilities.currentExtent;
+
+		return
 			   surfaceSize.width >= capabilities.minImageExtent.width
 			&& surfaceSize.width <= capabilities.maxImageExtent.width
 			&& surfaceSize.width > 0
 			&& surfaceSize.height >= capabilities.minImageExtent.height
 			&& surfaceSize.height <= capabilities.maxImageExtent.height
 			&& surfaceSize.height > 0
-		};
+		;
+	};
 
 
-		// cleanup old
-		vector<VkSemaphore> oldImageReadySs = imageReadySs; imageReadySs.clear();
-		if( oldSwapchain ){
-			{VkResult errorCode = vkDeviceWaitIdle( device ); RESULT_HANDLER( errorCode, "vkDeviceWaitIdle" );}
+	const std::function<bool(void)> recreateSwapchain = [&](){
+		// swapchain recreation -- will be done before the first frame too;
+		// satisfies any pending size change
+		resizePending = false;
+		const auto recreationBegin = Clock::now();
+
+		const VkSwapchainKHR oldSwapchain = swapchain;
+		swapchain = VK_NULL_HANDLE;
 
-			// fences might be in unsignaled state, so kill them too to get fresh signaled
-			killFences( device, submissionFences );
+		const VkSurfaceCapabilitiesKHR capabilities = getCapabilities();
+		const VkExtent2D surfaceSize = capabilities.currentExtent;
+		const bool swapchainCreatable = isSwapchainCreatable( capabilities );
 
-			// semaphores might be in signaled state, so kill them too to get fresh unsignaled
-			killSemaphores( device, renderDoneSs );
-			// kill imageReadySs later when oldSwapchain is destroyed
 
-			// only reset + later reuse already allocated and create new only if needed
-			{VkResult errorCode = vkResetCommandPool( device, commandPool, 0 ); RESULT_HANDLER( errorCode, "vkResetCommandPool" );}
+		// retire old
+		// frames still in flight may be using the old objects, so instead of waiting for the device to idle
+		// they go to the graveyard and are killed once the GPU is past them
+		if( oldSwapchain ){
+			// semaphores might be pending a wait, or in signaled state after VK_SUBOPTIMAL_KHR, so replace them with fresh unsignaled
+			vector<VkSemaphore> oldImageReadySs;
+			for( auto& frame : frames ){
+				oldImageReadySs.push_back( frame.imageReadyS );
+				frame.imageReadyS = initSemaphore( device );
+			}
+			// fences are reset only right before they are submitted, so they never get stuck unsignaled and can be kept
 
-			killPipeline( device, pipeline );
-			killFramebuffers( device, framebuffers );
-			killSwapchainImageViews( device, swapchainImageViews );
+			vector<VkSemaphore> oldRenderDoneSs; std::swap( oldRenderDoneSs, renderDoneSs );
+			vector<VkFramebuffer> oldFramebuffers; std::swap( oldFramebuffers, framebuffers );
+			vector<VkImageView> oldSwapchainImageViews; std::swap( oldSwapchainImageViews, swapchainImageViews );
 
-			// kill oldSwapchain later, after it is potentially used by vkCreateSwapchainKHR
+			// the last submission using these is lastSubmittedSerial, but presents cannot be tracked by it (the present queue can be a different one)
+			// with VK_EXT_swapchain_maintenance1 the fences of the presents track them
+			// otherwise a fence of an empty submit to the present queue after the last present stands in for them
+			// the spec does not order that submit after the presents though, so it is only a best effort
+			// https://github.com/KhronosGroup/Vulkan-Docs/issues/152
+			// oldSwapchain is used by vkCreateSwapchainKHR below, but collection happens only in render()
+			vector<VkFence> oldPresentFences; std::swap( oldPresentFences, presentFences );
+			if( !presentFenceSupport ){
+				oldPresentFences.push_back( initFence( device ) );
+				VkResult errorCode = vkQueueSubmit( presentQueue, 0, nullptr, oldPresentFences.back() ); RESULT_HANDLER( errorCode, "vkQueueSubmit" );
+			}
+			const auto presentsDone = [=](){
+				for( const VkFence fence : oldPresentFences ){
+					const VkResult status = vkGetFenceStatus( device, fence );
+					if( status == VK_NOT_READY ) return false;
+					RESULT_HANDLER( status, "vkGetFenceStatus" );
+				}
+				return true;
+			};
+			graveyard.bury(  lastSubmittedSerial, presentsDone, [=]() mutable{
+				killFences( device, oldPresentFences );
+				killSemaphores( device, oldRenderDoneSs );
+
+				killFramebuffers( device, oldFramebuffers );
+				killSwapchainImageViews( device, oldSwapchainImageViews );
+				killSwapchain( device, oldSwapchain );
+
+				// per current spec, we can't really be sure these are not used :/ at least kill them after the swapchain
+				// https://github.com/KhronosGroup/Vulkan-Docs/issues/152
+				killSemaphores( device, oldImageReadySs );
+			}  );
 		}
 
 		// creating new
 		if( swapchainCreatable ){
-			// reuses & destroys the oldSwapchain
+			// reuses & retires the oldSwapchain
 			swapchain = initSwapchain( physicalDevice, device, surface, surfaceFormat, capabilities, graphicsQueueFamily, presentQueueFamily, oldSwapchain );
+			swapchainExtent = surfaceSize;
 
 			vector<VkImage> swapchainImages = enumerate<VkImage>( device, swapchain );
 			swapchainImageViews = initSwapchainImageViews( device, swapchainImages, surfaceFormat.format );
 			framebuffers = initFramebuffers( device, renderPass, swapchainImageViews, surfaceSize.width, surfaceSize.height );
 
-			pipeline = initPipeline(
-				device,
-				physicalDeviceProperties.limits,
-				pipelineLayout,
-				renderPass,
-				vertexShader,
-				fragmentShader,
-				vertexBufferBinding,
-				surfaceSize.width, surfaceSize.height
-			);
-
-			acquireCommandBuffers(  device, commandPool, static_cast<uint32_t>( swapchainImages.size() ), commandBuffers  );
-			for( size_t i = 0; i < swapchainImages.size(); ++i ){
-				beginCommandBuffer( commandBuffers[i] );
-					recordBeginRenderPass( commandBuffers[i], renderPass, framebuffers[i], ::clearColor, surfaceSize.width, surfaceSize.height );
-
-					recordBindPipeline( commandBuffers[i], pipeline );
-					recordBindVertexBuffer( commandBuffers[i], vertexBufferBinding, vertexBuffer );
-
-					recordDraw(  commandBuffers[i], static_cast<uint32_t>( triangle.size() )  );
-
-					recordEndRenderPass( commandBuffers[i] );
-				endCommandBuffer( commandBuffers[i] );
-			}
-
-			imageReadySs = initSemaphores( device, maxInflightSubmissions );
-			// per https://github.com/KhronosGroup/Vulkan-Docs/issues/1150 need upto swapchain-image count
-			renderDoneSs = initSemaphores( device, swapchainImages.size());
+			renderDoneSs = initSemaphores( device, swapchainImages.size() );
+			if( presentFenceSupport ) presentFences = initFences( device, swapchainImages.size(), VK_FENCE_CREATE_SIGNALED_BIT ); // no present pending yet
 
-			submissionFences = initFences( device, maxInflightSubmissions, VK_FENCE_CREATE_SIGNALED_BIT ); // signaled fence means previous execution finished, so we start rendering presignaled
-			submissionNr = 0;
+			++swapchainRecreations;
+			const auto recreationTime = Clock::now() - recreationBegin;
+			recreationTimeTotal += recreationTime;
+			recreationTimeMax = std::max( recreationTimeMax, recreationTime );
 		}
 
-		if( oldSwapchain ){
-			killSwapchain( device, oldSwapchain );
+		return swapchain != VK_NULL_HANDLE;
+	};
 
-			// per current spec, we can't really be sure these are not used :/ at least kill them after the swapchain
-			// https://github.com/KhronosGroup/Vulkan-Docs/issues/152
-			killSemaphores( device, oldImageReadySs );
+	// WSI size event handler; only notes the new size -- render() does the recreation
+	// returns whether there is (or is going to be) a swapchain to render into
+	const std::function<bool(void)> handleSizeEvent = [&](){
+		const VkSurfaceCapabilitiesKHR capabilities = getCapabilities();
+
+		// e.g. minimized window; nothing to render into, so retire the swapchain now and let the message loop block
+		if(  !isSwapchainCreatable( capabilities )  ) return recreateSwapchain();
+
+		const bool sameSize = capabilities.currentExtent.width == swapchainExtent.width && capabilities.currentExtent.height == swapchainExtent.height;
+		if( swapchain && !resizePending && sameSize ){
+			++recreationsAvoided;
+			return true;
 		}
 
-		return swapchain != VK_NULL_HANDLE;
+		if( resizePending ) ++recreationsAvoided; // merged with the still pending one
+		resizePending = true;
+		lastSizeEventTime = Clock::now();
+
+		return true;
 	};
 
 
 	// Finally, rendering! Yay!
 	const std::function<void(void)> render = [&](){
+		PROFILE_ZONE( "render" );
+		const auto frameBegin = Clock::now();
+		beginFrameMeasurement();
+
+		// without swapchain there is nothing to show, so the pending size change cannot be debounced
+		const bool debouncing = resizePending && swapchain && Clock::now() - lastSizeEventTime < ::resizeDebounce;
+		if( resizePending && !debouncing ){
+			if( !recreateSwapchain() ) return;
+		}
+
 		assert( swapchain ); // should be always true; should have yielded CPU if false
 
 		// vkAcquireNextImageKHR produces unsafe semaphore that needs extra cleanup. Track that with this variable.
 		bool unsafeSemaphore = false;
+		bool submitted = false;
+
+		FrameContext& frame = frames[frameIndex];
 
 		try{
-			// remove oldest frame from being in flight before starting new one
-			// refer to doc/, which talks about the cycle of how the synch primitives are (re)used here
-			{VkResult errorCode = vkWaitForFences( device, 1, &submissionFences[submissionNr], VK_TRUE, UINT64_MAX ); RESULT_HANDLER( errorCode, "vkWaitForFences" );}
-			{VkResult errorCode = vkResetFences( device, 1, &submissionFences[submissionNr] ); RESULT_HANDLER( errorCode, "vkResetFences" );}
+			beginFrame( frame );
 
 			unsafeSemaphore = true;
-			uint32_t nextSwapchainImageIndex = getNextImageIndex( device, swapchain, imageReadySs[submissionNr] );
+			const auto acquireBegin = Clock::now();
+			uint32_t nextSwapchainImageIndex = getNextImageIndex( device, swapchain, frame.imageReadyS );
+			addFrameSample( "vkAcquireNextImageKHR", Clock::now() - acquireBegin );
 			unsafeSemaphore = false;
 
-			submitToQueue( graphicsQueue, commandBuffers[nextSwapchainImageIndex], imageReadySs[submissionNr], renderDoneSs[nextSwapchainImageIndex], submissionFences[submissionNr] );
-			present( presentQueue, swapchain, nextSwapchainImageIndex, renderDoneSs[nextSwapchainImageIndex] );
+			recordFrame( frame, framebuffers[nextSwapchainImageIndex], swapchainExtent );
+
+			submitFrame( frame, frame.imageReadyS, renderDoneSs[nextSwapchainImageIndex] );
+			submitted = true;
 
-			submissionNr = (submissionNr + 1) % maxInflightSubmissions;
+			// the previous present of the image should be long done, as the image was acquired again
+			const VkFence presentFence = presentFenceSupport ? presentFences[nextSwapchainImageIndex] : VK_NULL_HANDLE;
+			if( presentFence ){
+				VkResult errorCode = vkWaitForFences( device, 1, &presentFence, VK_TRUE, UINT64_MAX ); RESULT_HANDLER( errorCode, "vkWaitForFences" );
+				errorCode = vkResetFences( device, 1, &presentFence ); RESULT_HANDLER( errorCode, "vkResetFences" );
+			}
+
+			const auto presentBegin = Clock::now();
+			present( presentQueue, swapchain, nextSwapchainImageIndex, renderDoneSs[nextSwapchainImageIndex], presentFence );
+			addFrameSample( "vkQueuePresentKHR", Clock::now() - presentBegin );
+
+			reportStartup( "presented" );
+			endFrameMeasurement( frameBegin );
 		}
 		catch( VulkanResultException ex ){
-			if( ex.result == VK_SUBOPTIMAL_KHR || ex.result == VK_ERROR_OUT_OF_DATE_KHR ){
+			if( ex.result == VK_SUBOPTIMAL_KHR && submitted && debouncing ){
+				// the image was presented anyway; the recreation is already scheduled
+				++recreationsAvoided;
+			}
+			else if( ex.result == VK_SUBOPTIMAL_KHR || ex.result == VK_ERROR_OUT_OF_DATE_KHR ){
 				if( unsafeSemaphore && ex.result == VK_SUBOPTIMAL_KHR ){
-					cleanupUnsafeSemaphore( graphicsQueue, imageReadySs[submissionNr] );
+					cleanupUnsafeSemaphore( graphicsQueue, frame.imageReadyS );
 					// no way to sanitize vkQueuePresentKHR semaphores, really
 				}
-				recreateSwapchain();
 
 				// we need to start over...
-				render();
+				if( recreateSwapchain() ) render();
 			}
 			else throw;
 		}
 	};
 
 
-	setSizeEventHandler( recreateSwapchain );
+	setSizeEventHandler( handleSizeEvent );
 	setPaintEventHandler( render );
+	showWindow( window );
+#endif
 
 
 	// Finally start the main message loop (and so render too)
-	showWindow( window );
 	int exitStatus = messageLoop( window );
 
+#ifndef USE_PLATFORM_NONE
+	logger << "INFO: Swapchain created " << swapchainRecreations << " time(s); " << recreationsAvoided << " redundant recreation(s) avoided." << std::endl;
+	if( swapchainRecreations ){
+		logger << "INFO: Swapchain (re)creation took " << toMilliseconds( recreationTimeTotal ) / swapchainRecreations << " ms on average, "
+		       << toMilliseconds( recreationTimeMax ) << " ms at most." << std::endl;
+	}
+
+	frameStatistics.setCounter( "swapchainRecreations", swapchainRecreations );
+	frameStatistics.setCounter( "swapchainRecreationsAvoided", recreationsAvoided );
+#endif
+	reportMemoryStats();
+	writeBenchmarkReport();
+
 
 	// proper Vulkan cleanup
 	VkResult errorCode = vkDeviceWaitIdle( device ); RESULT_HANDLER( errorCode, "vkDeviceWaitIdle" );
 
+	graveyard.collectAll();
 
+#ifdef USE_PLATFORM_NONE
+	// kill offscreen targets
+	killFramebuffers( device, framebuffers );
+	killSwapchainImageViews( device, targetImageViews );
+	for( const auto image : targetImages ) killImage( device, image );
+	for( const auto& memory : targetImageMemories ) killMemory( memoryAllocator, memory );
+#else
 	// kill swapchain
+	// presents are not covered by vkDeviceWaitIdle
+	if( !presentFences.empty() ){
+		errorCode = vkWaitForFences( device, static_cast<uint32_t>( presentFences.size() ), presentFences.data(), VK_TRUE, UINT64_MAX ); RESULT_HANDLER( errorCode, "vkWaitForFences" );
+	}
+	killFences( device, presentFences );
 	killSemaphores( device, renderDoneSs );
 	// imageReadySs killed after the swapchain
 
-	// command buffers killed with pool
-
-	killPipeline( device, pipeline );
-
 	killFramebuffers( device, framebuffers );
 
 	killSwapchainImageViews( device, swapchainImageViews );
 	killSwapchain( device, swapchain );
 
-	// per current spec, we can't really be sure these are not used :/ at least kill them after the swapchain
+	// per current spec, we can't really be sure the frame contexts' imageReadySs are not used :/ at least kill them after the swapchain
 	// https://github.com/KhronosGroup/Vulkan-Docs/issues/152
-	killSemaphores( device, imageReadySs );
+#endif
 
+	// (command buffers are killed with their pools)
+	killFrameContexts( device, frames );
+	killSemaphore( device, frameTimeline );
 
-	// kill vulkan
-	killFences( device, submissionFences );
 
-	killCommandPool( device,  commandPool );
+	// kill vulkan
+	killQueryPool( device, statisticsPool );
+	killQueryPool( device, timestampPool );
+	killPipeline( device, pipeline );
+	if( pipelineCache ){
+		savePipelineCache( device, pipelineCache, physicalDeviceProperties, pipelineCacheFilename );
+		killPipelineCache( device, pipelineCache );
+	}
 
 	killBuffer( device, vertexBuffer );
-	killMemory( device, vertexBufferMemory );
+	killMemory( memoryAllocator, vertexBufferMemory );
+	if( indexBuffer ){
+		killBuffer( device, indexBuffer );
+		killMemory( memoryAllocator, indexBufferMemory );
+	}
+	if( instanceBuffer ){
+		killBuffer( device, instanceBuffer );
+		killMemory( memoryAllocator, instanceBufferMemory );
+	}
+	if( cullPipeline ){
+		// the device is idle, so the last frame's count is in
+		if( lastSubmittedSerial ){
+			const uint32_t lastFrameIndex = (frameIndex + frameCount - 1) % frameCount;
+			logger << "INFO: GPU culling kept " << cullStatistics[lastFrameIndex] << " of " << instanceCount << " instance(s) in the last frame." << std::endl;
+		}
+
+		killPipeline( device, cullPipeline );
+		killShaderModule( device, cullShader );
+		killBuffer( device, cullStatisticsBuffer );
+		killMemory( memoryAllocator, cullStatisticsBufferMemory );
+		killBuffer( device, survivorBuffer );
+		killMemory( memoryAllocator, survivorBufferMemory );
+	}
+	if( drawCommandPipeline ){
+		killPipeline( device, drawCommandPipeline );
+		killShaderModule( device, drawCommandShader );
+		killPipelineLayout( device, drawCommandPipelineLayout );
+		killDescriptorPool( device, descriptorPool );
+		killDescriptorSetLayout( device, drawCommandSetLayout );
+		killBuffer( device, drawCommandBuffer );
+		killMemory( memoryAllocator, drawCommandBufferMemory );
+	}
+
+	if( streaming.peakUsed() ) logger << "INFO: Streaming buffer used at most " << streaming.peakUsed() << " of " << streaming.capacity() << " B per frame." << std::endl;
+	killBuffer( device, streamingBuffer );
+	killMemory( memoryAllocator, streamingBufferMemory );
+
+	logger << "INFO: Uploaded " << uploader.getUploadedBytes() << " B in " << uploader.getSubmittedBatches() << " staging batch(es)." << std::endl;
+	uploader.kill();
 
 	killPipelineLayout( device, pipelineLayout );
 	killShaderModule( device, fragmentShader );
@@ -575,9 +1654,12 @@ int helloTriangle() try{
 
 	killRenderPass( device, renderPass );
 
+	memoryAllocator.kill();
 	killDevice( device );
 
+#ifndef USE_PLATFORM_NONE
 	killSurface( instance, surface );
+#endif
 	killWindow( window );
 
 #if VULKAN_VALIDATION
@@ -613,18 +1695,50 @@ catch( ... ){
 
 #if defined(_WIN32) && !defined(_CONSOLE)
 int WINAPI WinMain( HINSTANCE, HINSTANCE, LPSTR, int ){
-	return helloTriangle();
+	return helloTriangle(  vector<string>( __argv + 1, __argv + __argc )  );
 }
 #else
-int main(){
-	return helloTriangle();
+int main( int argc, char* argv[] ){
+	return helloTriangle(  vector<string>( argv + 1, argv + argc )  );
 }
 #endif
 
 // Implementation
 //////////////////////////////////////////////////////////////////////////////////
 
-bool isLayerSupported( const char* layer, const vector<VkLayerProperties>& supportedLayers ){
+BenchmarkSettings getBenchmarkSettings( const vector<string>& arguments ){
+	const auto parseFrameCount = []( const string& name, const string& value ) -> uint64_t{
+		uint64_t count;
+		if( !parseCount( value.c_str(), count ) ) throw name + " expects a frame count; got \"" + value + "\"!";
+		return count;
+	};
+
+	BenchmarkSettings settings{ ::defaultBenchmarkWarmupFrames, 0, "" };
+
+	if( const char* env = std::getenv( "HELLO_TRIANGLE_BENCHMARK_WARMUP" ) ) settings.warmupFrames = parseFrameCount( "HELLO_TRIANGLE_BENCHMARK_WARMUP", env );
+	if( const char* env = std::getenv( "HELLO_TRIANGLE_BENCHMARK_FRAMES" ) ) settings.measuredFrames = parseFrameCount( "HELLO_TRIANGLE_BENCHMARK_FRAMES", env );
+	if( const char* env = std::getenv( "HELLO_TRIANGLE_BENCHMARK_REPORT" ) ) settings.reportFilename = env;
+
+	for( size_t i = 0; i < arguments.size(); ++i ){
+		const string& argument = arguments[i];
+		const auto value = [&]() -> const string&{
+			if( i + 1 >= arguments.size() ) throw "Command line argument " + argument + " is missing its value!";
+			return arguments[++i];
+		};
+
+		if( argument == "--benchmark-warmup" ) settings.warmupFrames = parseFrameCount( argument, value() );
+		else if( argument == "--benchmark-frames" ) settings.measuredFrames = parseFrameCount( argument, value() );
+		else if( argument == "--benchmark-report" ) settings.reportFilename = value();
+		else{
+			// launchers can add their own (e.g. -psn_* on macOS), so these are not an error
+			logger << "WARNING: Ignoring unknown command line argument " << argument << ". Supported are --benchmark-frames N, --benchmark-warmup N, and --benchmark-report FILE." << std::endl;
+		}
+	}
+
+	return settings;
+}
+
+bool isLayerSupported( const char* layer, const vector<VkLayerProperties>& supportedLayers ){
 	const auto isSupportedPred = [layer]( const VkLayerProperties& prop ) -> bool{
 		return std::strcmp( layer, prop.layerName ) == 0;
 	};
@@ -695,6 +1809,8 @@ bool checkDeviceExtensionSupport( const VkPhysicalDevice physDevice, const vecto
 }
 
 VkInstance initInstance( const vector<const char*>& layers, const vector<const char*>& extensions ){
+	PROFILE_FUNCTION();
+
 	const VkApplicationInfo appInfo = {
 		VK_STRUCTURE_TYPE_APPLICATION_INFO,
 		nullptr, // pNext
@@ -755,6 +1871,7 @@ VkInstance initInstance( const vector<const char*>& layers, const vector<const c
 }
 
 void killInstance( const VkInstance instance ){
+	PROFILE_FUNCTION();
 	unloadInstanceExtensionsCommands( instance );
 
 	vkDestroyInstance( instance, nullptr );
@@ -835,6 +1952,50 @@ VkPhysicalDeviceMemoryProperties getPhysicalDeviceMemoryProperties( VkPhysicalDe
 	return memoryInfo;
 }
 
+VkPhysicalDeviceFeatures getPhysicalDeviceFeatures( VkPhysicalDevice physicalDevice ){
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures( physicalDevice, &features );
+	return features;
+}
+
+bool isTimelineSemaphoreSupported( const VkPhysicalDevice physicalDevice, const vector<const char*>& providingLayers ){
+	const auto supportedExtensions = getSupportedDeviceExtensions( physicalDevice, providingLayers );
+	if(  !isExtensionSupported( VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, supportedExtensions )  ) return false;
+
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+		nullptr, // pNext
+		VK_FALSE // timelineSemaphore
+	};
+	VkPhysicalDeviceFeatures2 features{
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		&timelineFeatures,
+		{} // features
+	};
+	vkGetPhysicalDeviceFeatures2KHR( physicalDevice, &features );
+
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+bool isSwapchainMaintenance1Supported( const VkPhysicalDevice physicalDevice, const vector<const char*>& providingLayers ){
+	const auto supportedExtensions = getSupportedDeviceExtensions( physicalDevice, providingLayers );
+	if(  !isExtensionSupported( VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME, supportedExtensions )  ) return false;
+
+	VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenance1Features{
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT,
+		nullptr, // pNext
+		VK_FALSE // swapchainMaintenance1
+	};
+	VkPhysicalDeviceFeatures2 features{
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		&swapchainMaintenance1Features,
+		{} // features
+	};
+	vkGetPhysicalDeviceFeatures2KHR( physicalDevice, &features );
+
+	return swapchainMaintenance1Features.swapchainMaintenance1 == VK_TRUE;
+}
+
 vector<VkQueueFamilyProperties> getQueueFamilyProperties( VkPhysicalDevice device ){
 	uint32_t queueFamiliesCount;
 	vkGetPhysicalDeviceQueueFamilyProperties( device, &queueFamiliesCount, nullptr );
@@ -865,7 +2026,10 @@ std::pair<uint32_t, uint32_t> getQueueFamilies( const VkPhysicalDevice physDevic
 
 	uint32_t graphicsQueueFamily = notFound;
 	uint32_t presentQueueFamily = notFound;
-	if( ::forceSeparatePresentQueue ){
+	if( !surface ){
+		graphicsQueueFamily = presentQueueFamily = findQueueFamilyThat( isGraphics );
+	}
+	else if( ::forceSeparatePresentQueue ){
 		graphicsQueueFamily = findQueueFamilyThat( isGraphics );
 
 		const auto isSeparatePresent = [graphicsQueueFamily, isPresent](const VkQueueFamilyProperties& props, const uint32_t queueFamily){
@@ -887,14 +2051,30 @@ std::pair<uint32_t, uint32_t> getQueueFamilies( const VkPhysicalDevice physDevic
 	return std::make_pair( graphicsQueueFamily, presentQueueFamily );
 }
 
+uint32_t getTransferQueueFamily( const VkPhysicalDevice physDevice, const uint32_t graphicsQueueFamily ){
+	if( !::useTransferQueue ) return graphicsQueueFamily;
+
+	const auto qfps = getQueueFamilyProperties( physDevice );
+	for( uint32_t qf = 0; qf < qfps.size(); ++qf ){
+		const VkQueueFlags flags = qfps[qf].queueFlags;
+		if( (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) ) return qf;
+	}
+
+	return graphicsQueueFamily; // graphics queue supports transfer implicitly
+}
+
 VkDevice initDevice(
 	const VkPhysicalDevice physDevice,
 	const VkPhysicalDeviceFeatures& features,
 	const uint32_t graphicsQueueFamily,
 	const uint32_t presentQueueFamily,
+	const uint32_t transferQueueFamily,
 	const vector<const char*>& layers,
-	const vector<const char*>& extensions
+	const vector<const char*>& extensions,
+	const void* featuresChain
 ){
+	PROFILE_FUNCTION();
+
 	checkDeviceExtensionSupport( physDevice, extensions, layers );
 
 	const float priority[] = {1.0f};
@@ -921,9 +2101,20 @@ VkDevice initDevice(
 		});
 	}
 
+	if( transferQueueFamily != graphicsQueueFamily && transferQueueFamily != presentQueueFamily ){
+		queues.push_back({
+			VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			nullptr, // pNext
+			0, // flags
+			transferQueueFamily,
+			1, // queue count
+			priority
+		});
+	}
+
 	const VkDeviceCreateInfo deviceInfo{
 		VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-		nullptr, // pNext
+		featuresChain, // pNext
 		0, // flags
 		static_cast<uint32_t>( queues.size() ),
 		queues.data(),
@@ -944,6 +2135,7 @@ VkDevice initDevice(
 }
 
 void killDevice( const VkDevice device ){
+	PROFILE_FUNCTION();
 	unloadDeviceExtensionsCommands( device );
 
 	vkDestroyDevice( device, nullptr );
@@ -976,6 +2168,41 @@ VkMemoryRequirements getMemoryRequirements< ResourceType::Image >( VkDevice devi
 	return memoryRequirements;
 }
 
+// needs VK_KHR_get_memory_requirements2 and VK_KHR_dedicated_allocation
+template< ResourceType resourceType, class T >
+VkMemoryRequirements getMemoryRequirements( VkDevice device, T resource, VkMemoryDedicatedRequirementsKHR& dedicatedRequirements );
+
+template<>
+VkMemoryRequirements getMemoryRequirements< ResourceType::Buffer >( VkDevice device, VkBuffer buffer, VkMemoryDedicatedRequirementsKHR& dedicatedRequirements ){
+	const VkBufferMemoryRequirementsInfo2KHR info{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2, nullptr, buffer };
+	VkMemoryRequirements2KHR memoryRequirements{ VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, &dedicatedRequirements, {} };
+	vkGetBufferMemoryRequirements2KHR( device, &info, &memoryRequirements );
+
+	return memoryRequirements.memoryRequirements;
+}
+
+template<>
+VkMemoryRequirements getMemoryRequirements< ResourceType::Image >( VkDevice device, VkImage image, VkMemoryDedicatedRequirementsKHR& dedicatedRequirements ){
+	const VkImageMemoryRequirementsInfo2KHR info{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2, nullptr, image };
+	VkMemoryRequirements2KHR memoryRequirements{ VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, &dedicatedRequirements, {} };
+	vkGetImageMemoryRequirements2KHR( device, &info, &memoryRequirements );
+
+	return memoryRequirements.memoryRequirements;
+}
+
+template< ResourceType resourceType, class T >
+VkMemoryDedicatedAllocateInfoKHR getDedicatedAllocateInfo( T resource );
+
+template<>
+VkMemoryDedicatedAllocateInfoKHR getDedicatedAllocateInfo< ResourceType::Buffer >( VkBuffer buffer ){
+	return { VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO, nullptr, VK_NULL_HANDLE, buffer };
+}
+
+template<>
+VkMemoryDedicatedAllocateInfoKHR getDedicatedAllocateInfo< ResourceType::Image >( VkImage image ){
+	return { VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO, nullptr, image, VK_NULL_HANDLE };
+}
+
 template< ResourceType resourceType, class T >
 void bindMemory( VkDevice device, T buffer, VkDeviceMemory memory, VkDeviceSize offset );
 
@@ -990,13 +2217,19 @@ void bindMemory< ResourceType::Image >( VkDevice device, VkImage image, VkDevice
 }
 
 template< ResourceType resourceType, class T >
-VkDeviceMemory initMemory(
+MemoryAllocation initMemory(
 	VkDevice device,
-	VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties,
+	DeviceMemoryAllocator& allocator,
 	T resource,
 	const std::vector<VkMemoryPropertyFlags>& memoryTypePriority
 ){
-	const VkMemoryRequirements memoryRequirements = getMemoryRequirements<resourceType>( device, resource );
+	PROFILE_FUNCTION();
+
+	VkMemoryDedicatedRequirementsKHR dedicatedRequirements{ VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS, nullptr, VK_FALSE, VK_FALSE };
+	const VkMemoryRequirements memoryRequirements = allocator.isDedicatedAllocationEnabled()
+		? getMemoryRequirements<resourceType>( device, resource, dedicatedRequirements )
+		: getMemoryRequirements<resourceType>( device, resource );
+	const VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties = allocator.getMemoryProperties();
 
 	const auto indexToBit = []( const uint32_t index ){ return 0x1 << index; };
 
@@ -1015,43 +2248,47 @@ VkDeviceMemory initMemory(
 
 	if( memoryType == memoryTypeNotFound ) throw "Can't find compatible mappable memory for the resource";
 
-	VkMemoryAllocateInfo memoryInfo{
-		VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		nullptr, // pNext
-		memoryRequirements.size,
-		memoryType
-	};
-
-	VkDeviceMemory memory;
-	VkResult errorCode = vkAllocateMemory( device, &memoryInfo, nullptr, &memory ); RESULT_HANDLER( errorCode, "vkAllocateMemory" );
-
-	bindMemory<resourceType>( device, resource, memory, 0 /*offset*/ );
+	const bool linear = resourceType == ResourceType::Buffer;
+	MemoryAllocation memory;
+	if( dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation ){
+		memory = allocator.allocateDedicated( memoryRequirements, memoryType, linear, getDedicatedAllocateInfo<resourceType>( resource ) );
+	}
+	else{
+		memory = allocator.allocate( memoryRequirements, memoryType, linear );
+	}
+	bindMemory<resourceType>( device, resource, memory.memory, memory.offset );
 
 	return memory;
 }
 
-void setMemoryData( VkDevice device, VkDeviceMemory memory, void* begin, size_t size ){
-	void* data;
-	VkResult errorCode = vkMapMemory( device, memory, 0 /*offset*/, VK_WHOLE_SIZE, 0 /*flags - reserved*/, &data ); RESULT_HANDLER( errorCode, "vkMapMemory" );
-	memcpy( data, begin, size );
-	vkUnmapMemory( device, memory );
+void setMemoryData( DeviceMemoryAllocator& allocator, const MemoryAllocation& memory, void* begin, size_t size ){
+	assert( size <= memory.size );
+	copyToHostMemory( allocator.map( memory ), begin, size, allocator.getMemoryPropertyFlags( memory ) );
+	allocator.flush( memory, 0, size );
 }
 
-void killMemory( VkDevice device, VkDeviceMemory memory ){
-	vkFreeMemory( device, memory, nullptr );
+void killMemory( DeviceMemoryAllocator& allocator, const MemoryAllocation& memory ){
+	PROFILE_FUNCTION();
+	allocator.free( memory );
 }
 
 
-VkBuffer initBuffer( VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage ){
+VkBuffer initBuffer( VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, vector<uint32_t> queueFamilies ){
+	PROFILE_FUNCTION();
+
+	std::sort( queueFamilies.begin(), queueFamilies.end() );
+	queueFamilies.erase(  std::unique( queueFamilies.begin(), queueFamilies.end() ), queueFamilies.end()  );
+	const bool concurrent = queueFamilies.size() > 1; // saves the queue family ownership transfers
+
 	VkBufferCreateInfo bufferInfo{
 		VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
 		nullptr, // pNext
 		0, // flags
 		size,
 		usage,
-		VK_SHARING_MODE_EXCLUSIVE,
-		0, // queue family count -- ignored for EXCLUSIVE
-		nullptr // queue families -- ignored for EXCLUSIVE
+		concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+		concurrent ? static_cast<uint32_t>( queueFamilies.size() ) : 0, // queue family count -- ignored for EXCLUSIVE
+		concurrent ? queueFamilies.data() : nullptr // queue families -- ignored for EXCLUSIVE
 	};
 
 	VkBuffer buffer;
@@ -1060,10 +2297,72 @@ VkBuffer initBuffer( VkDevice device, VkDeviceSize size, VkBufferUsageFlags usag
 }
 
 void killBuffer( VkDevice device, VkBuffer buffer ){
+	PROFILE_FUNCTION();
 	vkDestroyBuffer( device, buffer, nullptr );
 }
 
+void measureHostUploadBandwidth( VkDevice device, DeviceMemoryAllocator& allocator, FrameStatistics& statistics ){
+	PROFILE_FUNCTION();
+	using Clock = std::chrono::steady_clock;
+
+	const size_t size = static_cast<size_t>( ::hostUploadBenchmarkSize );
+	vector<unsigned char> source( size );
+	for( size_t i = 0; i < size; ++i ) source[i] = static_cast<unsigned char>( i * 7 );
+
+	const VkPhysicalDeviceMemoryProperties& memoryProperties = allocator.getMemoryProperties();
+	for( uint32_t memoryType = 0; memoryType < memoryProperties.memoryTypeCount; ++memoryType ){
+		const VkMemoryType& type = memoryProperties.memoryTypes[memoryType];
+		if( !(type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ) continue;
+
+		// the same kind of memory in the same heap would measure the same
+		const auto sameKind = [&]( const VkMemoryType& t ){ return t.propertyFlags == type.propertyFlags && t.heapIndex == type.heapIndex; };
+		if( std::any_of( memoryProperties.memoryTypes, memoryProperties.memoryTypes + memoryType, sameKind ) ) continue;
+
+		const VkBuffer buffer = initBuffer( device, ::hostUploadBenchmarkSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT );
+		VkMemoryRequirements memoryRequirements;
+		vkGetBufferMemoryRequirements( device, buffer, &memoryRequirements );
+		if( !(memoryRequirements.memoryTypeBits & (1u << memoryType)) ){
+			killBuffer( device, buffer );
+			continue;
+		}
+
+		const MemoryAllocation memory = allocator.allocate( memoryRequirements, memoryType, true /*linear*/ );
+		VkResult errorCode = vkBindBufferMemory( device, buffer, memory.memory, memory.offset ); RESULT_HANDLER( errorCode, "vkBindBufferMemory" );
+		void* const mapped = allocator.map( memory );
+
+		const string prefix = "hostUploadType" + to_string( memoryType );
+		statistics.setProperty( prefix, string( hostMemoryKindString( type.propertyFlags ) ) + ", heap " + to_string( type.heapIndex ) );
+
+		const auto measure = [&]( const char* path, void (*copy)( void*, const void*, size_t ) ){
+			copy( mapped, source.data(), size ); // warm-up; also faults in the mapping
+			allocator.flush( memory, 0, size );
+
+			double best = 0.0;
+			for( uint32_t i = 0; i < ::hostUploadBenchmarkRepetitions; ++i ){
+				const Clock::time_point begin = Clock::now();
+				copy( mapped, source.data(), size );
+				allocator.flush( memory, 0, size );
+				const double seconds = std::chrono::duration<double>( Clock::now() - begin ).count();
+
+				const double bandwidth = static_cast<double>( size ) / seconds / 1e9;
+				statistics.addSample( prefix + path, bandwidth, "GB/s" );
+				best = std::max( best, bandwidth );
+			}
+			logger << "INFO: Host upload into memory type " << memoryType << " (" << hostMemoryKindString( type.propertyFlags ) << ") by " << path << ": up to " << best << " GB/s." << std::endl;
+		};
+		measure( "Memcpy", []( void* d, const void* s, size_t n ){ std::memcpy( d, s, n ); } );
+		measure( "NonTemporal", copyNonTemporal );
+
+		killBuffer( device, buffer );
+		allocator.free( memory );
+	}
+
+	statistics.setProperty( "hostUploadNonTemporalIsa", nonTemporalCopyIsa() );
+}
+
 VkImage initImage( VkDevice device, VkFormat format, uint32_t width, uint32_t height, VkSampleCountFlagBits samples, VkImageUsageFlags usage ){
+	PROFILE_FUNCTION();
+
 	VkExtent3D size{
 		width,
 		height,
@@ -1095,10 +2394,13 @@ VkImage initImage( VkDevice device, VkFormat format, uint32_t width, uint32_t he
 }
 
 void killImage( VkDevice device, VkImage image ){
+	PROFILE_FUNCTION();
 	vkDestroyImage( device, image, nullptr );
 }
 
 VkImageView initImageView( VkDevice device, VkImage image, VkFormat format ){
+	PROFILE_FUNCTION();
+
 	VkImageViewCreateInfo iciv{
 		VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
 		nullptr, // pNext
@@ -1123,6 +2425,7 @@ VkImageView initImageView( VkDevice device, VkImage image, VkFormat format ){
 }
 
 void killImageView( VkDevice device, VkImageView imageView ){
+	PROFILE_FUNCTION();
 	vkDestroyImageView( device, imageView, nullptr );
 }
 
@@ -1131,6 +2434,7 @@ void killImageView( VkDevice device, VkImageView imageView ){
 // initSurface is platform dependent
 
 void killSurface( VkInstance instance, VkSurfaceKHR surface ){
+	PROFILE_FUNCTION();
 	vkDestroySurfaceKHR( instance, surface, nullptr );
 }
 
@@ -1222,6 +2526,8 @@ VkSwapchainKHR initSwapchain(
 	uint32_t presentQueueFamily,
 	VkSwapchainKHR oldSwapchain
 ){
+	PROFILE_FUNCTION();
+
 	// we don't care as we are always setting alpha to 1.0
 	VkCompositeAlphaFlagBitsKHR compositeAlphaFlag;
 	if( capabilities.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR ) compositeAlphaFlag = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
@@ -1266,6 +2572,7 @@ VkSwapchainKHR initSwapchain(
 }
 
 void killSwapchain( VkDevice device, VkSwapchainKHR swapchain ){
+	PROFILE_FUNCTION();
 	vkDestroySwapchainKHR( device, swapchain, nullptr );
 }
 
@@ -1284,6 +2591,8 @@ uint32_t getNextImageIndex( VkDevice device, VkSwapchainKHR swapchain, VkSemapho
 }
 
 vector<VkImageView> initSwapchainImageViews( VkDevice device, vector<VkImage> images, VkFormat format ){
+	PROFILE_FUNCTION();
+
 	vector<VkImageView> imageViews;
 
 	for( auto image : images ){
@@ -1296,23 +2605,26 @@ vector<VkImageView> initSwapchainImageViews( VkDevice device, vector<VkImage> im
 }
 
 void killSwapchainImageViews( VkDevice device, vector<VkImageView>& imageViews ){
+	PROFILE_FUNCTION();
 	for( auto imageView : imageViews ) vkDestroyImageView( device, imageView, nullptr );
 	imageViews.clear();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-VkRenderPass initRenderPass( VkDevice device, VkSurfaceFormatKHR surfaceFormat ){
+VkRenderPass initRenderPass( VkDevice device, VkFormat colorFormat, VkImageLayout finalLayout ){
+	PROFILE_FUNCTION();
+
 	VkAttachmentDescription colorAtachment{
 		0, // flags
-		surfaceFormat.format,
+		colorFormat,
 		VK_SAMPLE_COUNT_1_BIT,
 		VK_ATTACHMENT_LOAD_OP_CLEAR, // color + depth
 		VK_ATTACHMENT_STORE_OP_STORE, // color + depth
 		VK_ATTACHMENT_LOAD_OP_DONT_CARE, // stencil
 		VK_ATTACHMENT_STORE_OP_DONT_CARE, // stencil
 		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+		finalLayout
 	};
 
 	VkAttachmentReference colorReference{
@@ -1375,6 +2687,7 @@ VkRenderPass initRenderPass( VkDevice device, VkSurfaceFormatKHR surfaceFormat )
 }
 
 void killRenderPass( VkDevice device, VkRenderPass renderPass ){
+	PROFILE_FUNCTION();
 	vkDestroyRenderPass( device, renderPass, nullptr );
 }
 
@@ -1384,6 +2697,8 @@ vector<VkFramebuffer> initFramebuffers(
 	vector<VkImageView> imageViews,
 	uint32_t width, uint32_t height
 ){
+	PROFILE_FUNCTION();
+
 	vector<VkFramebuffer> framebuffers;
 
 	for( auto imageView : imageViews ){
@@ -1408,6 +2723,7 @@ vector<VkFramebuffer> initFramebuffers(
 }
 
 void killFramebuffers( VkDevice device, vector<VkFramebuffer>& framebuffers ){
+	PROFILE_FUNCTION();
 	for( auto framebuffer : framebuffers ) vkDestroyFramebuffer( device, framebuffer, nullptr );
 	framebuffers.clear();
 }
@@ -1442,12 +2758,15 @@ vector<Type> loadBinaryFile( string filename ){
 }
 
 VkShaderModule initShaderModule( VkDevice device, string filename ){
+	PROFILE_FUNCTION();
 	const auto shaderCode = loadBinaryFile<uint32_t>( filename );
 	if( shaderCode.empty() ) throw "SPIR-V shader file " + filename + " is invalid or read failed!";
 	return initShaderModule( device, shaderCode );
 }
 
 VkShaderModule initShaderModule( VkDevice device, const vector<uint32_t>& shaderCode ){
+	PROFILE_FUNCTION();
+
 	VkShaderModuleCreateInfo shaderModuleInfo{
 		VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
 		nullptr, // pNext
@@ -1463,10 +2782,13 @@ VkShaderModule initShaderModule( VkDevice device, const vector<uint32_t>& shader
 }
 
 void killShaderModule( VkDevice device, VkShaderModule shaderModule ){
+	PROFILE_FUNCTION();
 	vkDestroyShaderModule( device, shaderModule, nullptr );
 }
 
 VkPipelineLayout initPipelineLayout( VkDevice device ){
+	PROFILE_FUNCTION();
+
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{
 		VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 		nullptr, // pNext
@@ -1483,20 +2805,216 @@ VkPipelineLayout initPipelineLayout( VkDevice device ){
 	return pipelineLayout;
 }
 
+VkPipelineLayout initPipelineLayout( const VkDevice device, const VkDescriptorSetLayout descriptorSetLayout, const VkShaderStageFlags pushConstantStages, const uint32_t pushConstantSize ){
+	PROFILE_FUNCTION();
+
+	const VkPushConstantRange pushConstantRange{
+		pushConstantStages,
+		0, // offset
+		pushConstantSize
+	};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+		VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		nullptr, // pNext
+		0, // flags - reserved for future use
+		1, // descriptorSetLayout count
+		&descriptorSetLayout,
+		pushConstantSize ? 1u : 0u, // push constant range count
+		&pushConstantRange // push constant ranges
+	};
+
+	VkPipelineLayout pipelineLayout;
+	VkResult errorCode = vkCreatePipelineLayout( device, &pipelineLayoutInfo, nullptr, &pipelineLayout ); RESULT_HANDLER( errorCode, "vkCreatePipelineLayout" );
+
+	return pipelineLayout;
+}
+
 void killPipelineLayout( VkDevice device, VkPipelineLayout pipelineLayout ){
+	PROFILE_FUNCTION();
 	vkDestroyPipelineLayout( device, pipelineLayout, nullptr );
 }
 
+VkDescriptorSetLayout initDescriptorSetLayout( const VkDevice device, const vector<VkDescriptorType>& bindingTypes, const VkShaderStageFlags stages ){
+	PROFILE_FUNCTION();
+
+	vector<VkDescriptorSetLayoutBinding> bindings;
+	for( uint32_t i = 0; i < bindingTypes.size(); ++i ){
+		bindings.push_back(  {
+			i, // binding
+			bindingTypes[i],
+			1, // descriptor count
+			stages,
+			nullptr // immutable samplers
+		}  );
+	}
+
+	const VkDescriptorSetLayoutCreateInfo layoutInfo{
+		VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		nullptr, // pNext
+		0, // flags
+		static_cast<uint32_t>( bindings.size() ), bindings.data()
+	};
+
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkResult errorCode = vkCreateDescriptorSetLayout( device, &layoutInfo, nullptr, &descriptorSetLayout ); RESULT_HANDLER( errorCode, "vkCreateDescriptorSetLayout" );
+
+	return descriptorSetLayout;
+}
+
+void killDescriptorSetLayout( const VkDevice device, const VkDescriptorSetLayout descriptorSetLayout ){
+	PROFILE_FUNCTION();
+	vkDestroyDescriptorSetLayout( device, descriptorSetLayout, nullptr );
+}
+
+VkDescriptorPool initDescriptorPool( const VkDevice device, const vector<VkDescriptorType>& bindingTypes, const uint32_t setCount ){
+	PROFILE_FUNCTION();
+
+	vector<VkDescriptorPoolSize> poolSizes;
+	for( const VkDescriptorType type : bindingTypes ){
+		const auto poolSize = std::find_if( poolSizes.begin(), poolSizes.end(), [type]( const VkDescriptorPoolSize& ps ){ return ps.type == type; } );
+		if( poolSize == poolSizes.end() ) poolSizes.push_back( {type, setCount} );
+		else poolSize->descriptorCount += setCount;
+	}
+
+	const VkDescriptorPoolCreateInfo poolInfo{
+		VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		nullptr, // pNext
+		0, // flags; sets are never freed individually
+		setCount, // max sets
+		static_cast<uint32_t>( poolSizes.size() ), poolSizes.data()
+	};
+
+	VkDescriptorPool descriptorPool;
+	VkResult errorCode = vkCreateDescriptorPool( device, &poolInfo, nullptr, &descriptorPool ); RESULT_HANDLER( errorCode, "vkCreateDescriptorPool" );
+
+	return descriptorPool;
+}
+
+void killDescriptorPool( const VkDevice device, const VkDescriptorPool descriptorPool ){
+	PROFILE_FUNCTION();
+	vkDestroyDescriptorPool( device, descriptorPool, nullptr );
+}
+
+VkDescriptorSet allocateDescriptorSet( const VkDevice device, const VkDescriptorPool descriptorPool, const VkDescriptorSetLayout descriptorSetLayout ){
+	const VkDescriptorSetAllocateInfo allocateInfo{
+		VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		nullptr, // pNext
+		descriptorPool,
+		1, &descriptorSetLayout
+	};
+
+	VkDescriptorSet descriptorSet;
+	VkResult errorCode = vkAllocateDescriptorSets( device, &allocateInfo, &descriptorSet ); RESULT_HANDLER( errorCode, "vkAllocateDescriptorSets" );
+
+	return descriptorSet;
+}
+
+void writeBufferDescriptor( const VkDevice device, const VkDescriptorSet descriptorSet, const uint32_t binding, const VkDescriptorType type, const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize range ){
+	const VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+
+	const VkWriteDescriptorSet write{
+		VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		nullptr, // pNext
+		descriptorSet,
+		binding,
+		0, // array element
+		1, // descriptor count
+		type,
+		nullptr, // image info
+		&bufferInfo,
+		nullptr // texel buffer views
+	};
+	vkUpdateDescriptorSets( device, 1, &write, 0, nullptr );
+}
+
+bool isPipelineCacheDataCompatible( const void* data, const size_t dataSize, const VkPhysicalDeviceProperties& properties ){
+	VkPipelineCacheHeaderVersionOne header;
+	if( !data || dataSize < sizeof( header ) ) return false;
+	std::memcpy( &header, data, sizeof( header ) ); // data need not be aligned
+
+	return header.headerSize >= sizeof( header )
+	    && header.headerSize <= dataSize
+	    && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+	    && header.vendorID == properties.vendorID
+	    && header.deviceID == properties.deviceID
+	    && std::memcmp( header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE ) == 0;
+}
+
+VkPipelineCache initPipelineCache( VkDevice device, const void* initialData, const size_t initialDataSize ){
+	PROFILE_FUNCTION();
+
+	const VkPipelineCacheCreateInfo pipelineCacheInfo{
+		VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		nullptr, // pNext
+		0, // flags
+		initialDataSize,
+		initialData
+	};
+
+	VkPipelineCache pipelineCache;
+	VkResult errorCode = vkCreatePipelineCache( device, &pipelineCacheInfo, nullptr, &pipelineCache ); RESULT_HANDLER( errorCode, "vkCreatePipelineCache" );
+
+	return pipelineCache;
+}
+
+std::pair<VkPipelineCache, bool> loadPipelineCache( VkDevice device, const VkPhysicalDeviceProperties& properties, const string& filename ){
+	const MappedFile file( filename ); // unmapped on return; the implementation copies what it needs
+
+	if( file.empty() ){
+		logger << "INFO: No pipeline cache file " << filename << "; starting with cold pipeline cache." << std::endl;
+		return { initPipelineCache( device ), false };
+	}
+
+	if( !isPipelineCacheDataCompatible( file.data(), file.size(), properties ) ){
+		logger << "WARNING: Pipeline cache file " << filename << " is from different device or driver; ignoring it." << std::endl;
+		return { initPipelineCache( device ), false };
+	}
+
+	logger << "INFO: Loaded " << file.size() << " B of pipeline cache from " << filename << "." << std::endl;
+	return { initPipelineCache( device, file.data(), file.size() ), true };
+}
+
+void savePipelineCache( VkDevice device, VkPipelineCache pipelineCache, const VkPhysicalDeviceProperties& properties, const string& filename ){
+	{
+		const MappedFile file( filename ); // must be unmapped before the file is replaced
+		if( isPipelineCacheDataCompatible( file.data(), file.size(), properties ) ){
+			const VkPipelineCache fileCache = initPipelineCache( device, file.data(), file.size() );
+			VkResult errorCode = vkMergePipelineCaches( device, pipelineCache, 1, &fileCache ); RESULT_HANDLER( errorCode, "vkMergePipelineCaches" );
+			killPipelineCache( device, fileCache );
+		}
+	}
+
+	size_t dataSize;
+	VkResult errorCode = vkGetPipelineCacheData( device, pipelineCache, &dataSize, nullptr ); RESULT_HANDLER( errorCode, "vkGetPipelineCacheData" );
+	vector<uint8_t> data( dataSize );
+	errorCode = vkGetPipelineCacheData( device, pipelineCache, &dataSize, data.data() ); RESULT_HANDLER( errorCode, "vkGetPipelineCacheData" );
+
+	if( writeFileAtomically( filename, data.data(), dataSize ) ) logger << "INFO: Saved " << dataSize << " B of pipeline cache to " << filename << "." << std::endl;
+	else logger << "WARNING: Failed to write pipeline cache file " << filename << "." << std::endl;
+}
+
+void killPipelineCache( VkDevice device, VkPipelineCache pipelineCache ){
+	PROFILE_FUNCTION();
+	vkDestroyPipelineCache( device, pipelineCache, nullptr );
+}
+
 VkPipeline initPipeline(
 	VkDevice device,
+	VkPipelineCache pipelineCache,
 	VkPhysicalDeviceLimits limits,
 	VkPipelineLayout pipelineLayout,
 	VkRenderPass renderPass,
 	VkShaderModule vertexShader,
 	VkShaderModule fragmentShader,
 	const uint32_t vertexBufferBinding,
-	uint32_t width, uint32_t height
-){/*
+	const VertexLayout vertexLayout,
+	const bool instanced,
+	const uint32_t instanceBufferBinding
+){
+	PROFILE_FUNCTION();
+
+	/*
 	const VkPipelineShaderStageCreateInfo vertexShaderStage{
 		VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 		nullptr, // pNext
@@ -1538,59 +3056,39 @@ VkPipeline initPipeline(
 		}
 	};
 
-	const uint32_t vertexBufferStride = sizeof( Vertex2D_ColorF_pack );
-	if( vertexBufferBinding > limits.maxVertexInputBindings ){
-		throw string("Implementation does not allow enough input bindings. Needed: ")
-		    + to_string( vertexBufferBinding ) + string(", max: ")
-		    + to_string( limits.maxVertexInputBindings );
-	}
-	if( vertexBufferStride > limits.maxVertexInputBindingStride ){
-		throw string("Implementation does not allow big enough vertex buffer stride: ")
-		    + to_string( vertexBufferStride ) 
-		    + string(", max: ")
-		    + to_string( limits.maxVertexInputBindingStride );
+	// generated from the VertexTraits of the layout's vertex struct (and of the instance struct)
+	const VertexInputDescriptions vertexInput = getVertexInputDescriptions( vertexLayout, vertexBufferBinding );
+	vector<VkVertexInputBindingDescription> inputBindingDescriptions = { vertexInput.binding };
+	vector<VkVertexInputAttributeDescription> inputAttributeDescriptions = vertexInput.attributes;
+	uint32_t maxAttributeOffset = vertexInput.maxAttributeOffset;
+	if( instanced ){
+		const VertexInputDescriptions instanceInput = getVertexInputDescriptions<Instance2D_ColorU8>( instanceBufferBinding );
+		inputBindingDescriptions.push_back( instanceInput.binding );
+		inputAttributeDescriptions.insert( inputAttributeDescriptions.end(), instanceInput.attributes.begin(), instanceInput.attributes.end() );
+		maxAttributeOffset = std::max( maxAttributeOffset, instanceInput.maxAttributeOffset );
 	}
 
-	VkVertexInputBindingDescription vertexInputBindingDescription{
-		vertexBufferBinding,
-		sizeof( Vertex2D_ColorF_pack ), // stride in bytes
-		VK_VERTEX_INPUT_RATE_VERTEX
-	};
-
-	vector<VkVertexInputBindingDescription> inputBindingDescriptions = { vertexInputBindingDescription };
-	if( inputBindingDescriptions.size() > limits.maxVertexInputBindings ){
-		throw "Implementation does not allow enough input bindings.";
+	for( const auto& binding : inputBindingDescriptions ){
+		if( binding.binding >= limits.maxVertexInputBindings ){
+			throw string("Implementation does not allow enough input bindings. Needed: ")
+			    + to_string( binding.binding + 1 ) + string(", max: ")
+			    + to_string( limits.maxVertexInputBindings );
+		}
+		if( binding.stride > limits.maxVertexInputBindingStride ){
+			throw string("Implementation does not allow big enough vertex buffer stride: ")
+			    + to_string( binding.stride ) 
+			    + string(", max: ")
+			    + to_string( limits.maxVertexInputBindingStride );
+		}
 	}
 
-	const uint32_t positionLocation = 0;
-	const uint32_t colorLocation = 1;
-
-	if( colorLocation >= limits.maxVertexInputAttributes ){
+	if( inputAttributeDescriptions.size() > limits.maxVertexInputAttributes ){
 		throw "Implementation does not allow enough input attributes.";
 	}
-	if( offsetof( Vertex2D_ColorF_pack, color ) > limits.maxVertexInputAttributeOffset ){
+	if( maxAttributeOffset > limits.maxVertexInputAttributeOffset ){
 		throw "Implementation does not allow sufficient attribute offset.";
 	}
 
-	VkVertexInputAttributeDescription positionInputAttributeDescription{
-		positionLocation,
-		vertexBufferBinding,
-		VK_FORMAT_R32G32_SFLOAT,
-		offsetof( Vertex2D_ColorF_pack, position ) // offset in bytes
-	};
-
-	VkVertexInputAttributeDescription colorInputAttributeDescription{
-		colorLocation,
-		vertexBufferBinding,
-		VK_FORMAT_R32G32B32_SFLOAT,
-		offsetof( Vertex2D_ColorF_pack, color ) // offset in bytes
-	};
-
-	vector<VkVertexInputAttributeDescription> inputAttributeDescriptions = {
-		positionInputAttributeDescription,
-		colorInputAttributeDescription
-	};
-
 	VkPipelineVertexInputStateCreateInfo vertexInputState{
 		VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
 		nullptr, // pNext
@@ -1609,28 +3107,14 @@ VkPipeline initPipeline(
 		VK_FALSE // primitive restart
 	};
 
-	VkViewport viewport{
-		0.0f, // x
-		0.0f, // y
-		static_cast<float>( width ? width : 1 ),
-		static_cast<float>( height ? height : 1 ),
-		0.0f, // min depth
-		1.0f // max depth
-	};
-
-	VkRect2D scissor{
-		{0, 0}, // offset
-		{width, height}
-	};
-
 	VkPipelineViewportStateCreateInfo viewportState{
 		VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
 		nullptr, // pNext
 		0, // flags - reserved for future use
 		1, // Viewport count
-		&viewport,
+		nullptr, // dynamic
 		1, // scisor count,
-		&scissor
+		nullptr // dynamic
 	};
 
 	VkPipelineRasterizationStateCreateInfo rasterizationState{
@@ -1683,6 +3167,17 @@ VkPipeline initPipeline(
 		{0.0f, 0.0f, 0.0f, 0.0f} // blend constants
 	};
 
+	// set in command buffer, so the pipeline does not have to be recreated with the swapchain
+	const VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicState{
+		VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		nullptr, // pNext
+		0, // flags - reserved for future use
+		2, // dynamic state count
+		dynamicStates
+	};
+
 	VkGraphicsPipelineCreateInfo pipelineInfo{
 		VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
 		nullptr, // pNext
@@ -1697,7 +3192,7 @@ VkPipeline initPipeline(
 		&multisampleState,
 		nullptr, // depth stencil
 		&colorBlendState,
-		nullptr, // dynamic state
+		&dynamicState,
 		pipelineLayout,
 		renderPass,
 		0, // subpass index in renderpass
@@ -1708,7 +3203,7 @@ VkPipeline initPipeline(
 	VkPipeline pipeline;
 	VkResult errorCode = vkCreateGraphicsPipelines(
 		device,
-		VK_NULL_HANDLE /* pipeline cache */,
+		pipelineCache,
 		1 /* info count */,
 		&pipelineInfo,
 		nullptr,
@@ -1717,18 +3212,131 @@ VkPipeline initPipeline(
 	return pipeline;
 }
 
+VkPipeline initComputePipeline( const VkDevice device, const VkPipelineCache pipelineCache, const VkPipelineLayout pipelineLayout, const VkShaderModule computeShader ){
+	PROFILE_FUNCTION();
+
+	const VkComputePipelineCreateInfo pipelineInfo{
+		VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		nullptr, // pNext
+		0, // flags
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			nullptr, // pNext
+			0, // flags - reserved for future use
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			computeShader,
+			u8"main",
+			nullptr // SpecializationInfo
+		},
+		pipelineLayout,
+		VK_NULL_HANDLE, // base pipeline
+		-1 // base pipeline index
+	};
+
+	VkPipeline pipeline;
+	VkResult errorCode = vkCreateComputePipelines( device, pipelineCache, 1 /* info count */, &pipelineInfo, nullptr, &pipeline ); RESULT_HANDLER( errorCode, "vkCreateComputePipelines" );
+	return pipeline;
+}
+
 void killPipeline( VkDevice device, VkPipeline pipeline ){
+	PROFILE_FUNCTION();
 	vkDestroyPipeline( device, pipeline, nullptr );
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void setVertexData( VkDevice device, VkDeviceMemory memory, vector<Vertex2D_ColorF_pack> vertices ){
-	TODO( "Should be in Device Local memory instead" )
-	setMemoryData(  device, memory, vertices.data(), sizeof( decltype(vertices)::value_type ) * vertices.size()  );
+template< typename Vertex >
+void setVertexData( StagingUploader& uploader, VkBuffer buffer, const vector<Vertex>& vertices ){
+	uploader.upload(  buffer, 0 /*offset*/, vertices.data(), sizeof( Vertex ) * vertices.size()  );
+}
+
+void setMeshData( StagingUploader& uploader, const MeshFile& mesh, VkBuffer vertexBuffer, VkBuffer indexBuffer ){
+	PROFILE_FUNCTION();
+
+	const MeshFileHeader& header = mesh.getHeader();
+	for( uint32_t i = 0; i < mesh.getChunkCount(); ++i ){
+		const MeshFileChunk& chunk = mesh.getChunk( i );
+		const bool vertices = chunk.type == static_cast<uint32_t>( MeshChunkType::Vertices );
+		const VkDeviceSize elementSize = vertices ? header.vertexStride : header.indexSize;
+
+		// robustBufferAccess is off, so an index past the vertices would make the vertex fetch read out of bounds
+		if(  !mesh.chunkIndicesInRange( i )  ) throw string( "Mesh has an index out of the vertex range!" );
+		uploader.upload( vertices ? vertexBuffer : indexBuffer, chunk.firstElement * elementSize, mesh.getChunkData( i ), chunk.size );
+		mesh.releaseChunk( i ); // already copied into the staging memory
+	}
+}
+
+OptimizedMesh loadOptimizedMesh( const MeshFile& mesh, const uint32_t cacheSize ){
+	PROFILE_FUNCTION();
+
+	const MeshFileHeader& header = mesh.getHeader();
+	const size_t vertexCount = static_cast<size_t>( header.vertexCount );
+	const size_t indexCount = static_cast<size_t>( header.indexCount );
+
+	OptimizedMesh optimized{ vector<unsigned char>( vertexCount * header.vertexStride ), vector<unsigned char>( indexCount * header.indexSize ), {}, {} };
+	for( uint32_t i = 0; i < mesh.getChunkCount(); ++i ){
+		const MeshFileChunk& chunk = mesh.getChunk( i );
+		const bool vertices = chunk.type == static_cast<uint32_t>( MeshChunkType::Vertices );
+		const size_t elementSize = vertices ? header.vertexStride : header.indexSize;
+
+		std::memcpy( (vertices ? optimized.vertices : optimized.indices).data() + chunk.firstElement * elementSize, mesh.getChunkData( i ), static_cast<size_t>( chunk.size ) );
+		mesh.releaseChunk( i );
+	}
+
+	const auto optimize = [&]( auto* const indices ){
+		for( size_t i = 0; i < indexCount; ++i ) if( indices[i] >= vertexCount ) throw string( "Mesh has an index out of the vertex range!" );
+
+		optimized.before = analyzeVertexCache( indices, indexCount, vertexCount, cacheSize );
+		optimizeVertexCache( indices, indexCount, vertexCount, cacheSize );
+		optimizeVertexFetch( optimized.vertices.data(), vertexCount, header.vertexStride, indices, indexCount );
+		optimized.after = analyzeVertexCache( indices, indexCount, vertexCount, cacheSize );
+	};
+	if( header.indexSize == 2 ) optimize( reinterpret_cast<uint16_t*>( optimized.indices.data() ) );
+	else optimize( reinterpret_cast<uint32_t*>( optimized.indices.data() ) );
+
+	return optimized;
+}
+
+uint32_t getInstanceCount(){
+	const uint64_t requested = getEnvironmentCount( "HELLO_TRIANGLE_INSTANCES", ::instanceCount );
+	if( requested > ::maxInstanceCount ){
+		logger << "WARNING: HELLO_TRIANGLE_INSTANCES=" << requested << " is out of the range 0 to " << ::maxInstanceCount << "; clamping." << std::endl;
+	}
+
+	return static_cast<uint32_t>(  std::min<uint64_t>( requested, ::maxInstanceCount )  );
+}
+
+vector<Instance2D_ColorU8> generateInstanceGrid( const uint32_t count, const float modelSize ){
+	PROFILE_FUNCTION();
+
+	const uint32_t side = static_cast<uint32_t>(  std::ceil( std::sqrt( static_cast<double>( count ) ) )  );
+	const float cellSize = 2.0f / static_cast<float>( side );
+	const float scale = 0.9f * cellSize / modelSize; // a bit of a gap between the neighbours
+
+	vector<Instance2D_ColorU8> instances;
+	instances.reserve( count );
+	for( uint32_t i = 0; i < count; ++i ){
+		const uint32_t x = i % side;
+		const uint32_t y = i / side;
+
+		// cheap hash, so the neighbours get visibly different tints
+		uint32_t h = i * 2654435761u;
+		h ^= h >> 15;
+		const auto tint = [h]( const int shift ){ return static_cast<uint8_t>( 128 + ((h >> shift) & 127) ); };
+
+		instances.push_back(  {
+			{ -1.0f + (static_cast<float>( x ) + 0.5f) * cellSize, -1.0f + (static_cast<float>( y ) + 0.5f) * cellSize },
+			scale,
+			{ {tint( 0 ), tint( 8 ), tint( 16 ), 255} }
+		}  );
+	}
+
+	return instances;
 }
 
 VkSemaphore initSemaphore( VkDevice device ){
+	PROFILE_FUNCTION();
+
 	const VkSemaphoreCreateInfo semaphoreInfo{
 		VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
 		nullptr, // pNext
@@ -1741,25 +3349,68 @@ VkSemaphore initSemaphore( VkDevice device ){
 }
 
 vector<VkSemaphore> initSemaphores( VkDevice device, size_t count ){
+	PROFILE_FUNCTION();
 	vector<VkSemaphore> semaphores;
 	std::generate_n(  std::back_inserter( semaphores ), count, [device]{ return initSemaphore( device ); }  );
 	return semaphores;
 }
 
 void killSemaphore( VkDevice device, VkSemaphore semaphore ){
+	PROFILE_FUNCTION();
 	vkDestroySemaphore( device, semaphore, nullptr );
 }
 
 void killSemaphores( VkDevice device, vector<VkSemaphore>& semaphores ){
+	PROFILE_FUNCTION();
 	for( const auto s : semaphores ) killSemaphore( device, s );
 	semaphores.clear();
 }
 
-VkCommandPool initCommandPool( VkDevice device, const uint32_t queueFamily ){
+VkSemaphore initTimelineSemaphore( VkDevice device, uint64_t initialValue ){
+	PROFILE_FUNCTION();
+
+	const VkSemaphoreTypeCreateInfoKHR semaphoreTypeInfo{
+		VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		nullptr, // pNext
+		VK_SEMAPHORE_TYPE_TIMELINE,
+		initialValue
+	};
+
+	const VkSemaphoreCreateInfo semaphoreInfo{
+		VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		&semaphoreTypeInfo, // pNext
+		0 // flags - reserved for future use
+	};
+
+	VkSemaphore semaphore;
+	VkResult errorCode = vkCreateSemaphore( device, &semaphoreInfo, nullptr, &semaphore ); RESULT_HANDLER( errorCode, "vkCreateSemaphore" );
+	return semaphore;
+}
+
+void waitTimelineSemaphore( VkDevice device, VkSemaphore timelineS, uint64_t value ){
+	const VkSemaphoreWaitInfoKHR waitInfo{
+		VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		nullptr, // pNext
+		0, // flags
+		1, &timelineS, &value
+	};
+
+	VkResult errorCode = vkWaitSemaphoresKHR( device, &waitInfo, UINT64_MAX ); RESULT_HANDLER( errorCode, "vkWaitSemaphoresKHR" );
+}
+
+uint64_t getTimelineSemaphoreValue( VkDevice device, VkSemaphore timelineS ){
+	uint64_t value;
+	VkResult errorCode = vkGetSemaphoreCounterValueKHR( device, timelineS, &value ); RESULT_HANDLER( errorCode, "vkGetSemaphoreCounterValueKHR" );
+	return value;
+}
+
+VkCommandPool initCommandPool( VkDevice device, const uint32_t queueFamily, const VkCommandPoolCreateFlags flags ){
+	PROFILE_FUNCTION();
+
 	const VkCommandPoolCreateInfo commandPoolInfo{
 		VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
 		nullptr, // pNext
-		0, // flags
+		flags,
 		queueFamily
 	};
 
@@ -1769,10 +3420,13 @@ VkCommandPool initCommandPool( VkDevice device, const uint32_t queueFamily ){
 }
 
 void killCommandPool( VkDevice device, VkCommandPool commandPool ){
+	PROFILE_FUNCTION();
 	vkDestroyCommandPool( device, commandPool, nullptr );
 }
 
-VkFence initFence( const VkDevice device, const VkFenceCreateFlags flags = 0 ){
+VkFence initFence( const VkDevice device, const VkFenceCreateFlags flags ){
+	PROFILE_FUNCTION();
+
 	const VkFenceCreateInfo fci{
 		VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
 		nullptr, // pNext
@@ -1785,20 +3439,107 @@ VkFence initFence( const VkDevice device, const VkFenceCreateFlags flags = 0 ){
 }
 
 void killFence( const VkDevice device, const VkFence fence ){
+	PROFILE_FUNCTION();
 	vkDestroyFence( device, fence, nullptr );
 }
 
 vector<VkFence> initFences( const VkDevice device, const size_t count, const VkFenceCreateFlags flags ){
+	PROFILE_FUNCTION();
 	vector<VkFence> fences;
 	std::generate_n(  std::back_inserter( fences ), count, [=]{return initFence( device, flags );}  );
 	return fences;
 }
 
 void killFences( const VkDevice device, vector<VkFence>& fences ){
+	PROFILE_FUNCTION();
 	for( const auto f : fences ) killFence( device, f );
 	fences.clear();
 }
 
+uint32_t getFramesInFlight(){
+	const uint64_t requested = getEnvironmentCount( "HELLO_TRIANGLE_FRAMES_IN_FLIGHT", ::framesInFlight );
+	if( requested < 1 || requested > ::maxFramesInFlight ){
+		logger << "WARNING: HELLO_TRIANGLE_FRAMES_IN_FLIGHT=" << requested << " is out of the range 1 to " << ::maxFramesInFlight << "; clamping." << std::endl;
+	}
+
+	return static_cast<uint32_t>(  std::min<uint64_t>( std::max<uint64_t>( requested, 1 ), ::maxFramesInFlight )  );
+}
+
+vector<FrameContext> initFrameContexts( const VkDevice device, const uint32_t queueFamily, const uint32_t count, const bool withFences ){
+	PROFILE_FUNCTION();
+
+	vector<FrameContext> frames;
+	frames.reserve( count );
+
+	for( uint32_t i = 0; i < count; ++i ){
+		FrameContext frame{
+			// signaled fence means previous execution finished, so we start rendering presignaled
+			withFences ? initFence( device, VK_FENCE_CREATE_SIGNALED_BIT ) : VK_NULL_HANDLE,
+			0, // submissionSerial -- timeline starts at 0, so also means "finished"
+			initSemaphore( device ),
+			initCommandPool( device, queueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT ), // buffers are short-lived; re-recorded every frame
+			VK_NULL_HANDLE,
+			false, // queriesPending
+			ScratchAllocator( ::frameScratchSize )
+		};
+
+		vector<VkCommandBuffer> commandBuffers;
+		acquireCommandBuffers( device, frame.commandPool, 1, commandBuffers );
+		frame.commandBuffer = commandBuffers[0];
+
+		frames.push_back( std::move( frame ) );
+	}
+
+	return frames;
+}
+
+void killFrameContexts( const VkDevice device, vector<FrameContext>& frames ){
+	PROFILE_FUNCTION();
+
+	for( auto& frame : frames ){
+		unregisterCommandBuffers( 1, &frame.commandBuffer );
+		killCommandPool( device, frame.commandPool );
+		killSemaphore( device, frame.imageReadyS );
+		killFence( device, frame.fence );
+	}
+	frames.clear();
+}
+
+VkQueryPool initQueryPool( const VkDevice device, const VkQueryType queryType, const uint32_t count, const VkQueryPipelineStatisticFlags pipelineStatistics ){
+	PROFILE_FUNCTION();
+
+	const VkQueryPoolCreateInfo queryPoolInfo{
+		VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		nullptr, // pNext
+		0, // flags - reserved for future use
+		queryType,
+		count,
+		pipelineStatistics
+	};
+
+	VkQueryPool queryPool;
+	VkResult errorCode = vkCreateQueryPool( device, &queryPoolInfo, nullptr, &queryPool ); RESULT_HANDLER( errorCode, "vkCreateQueryPool" );
+	return queryPool;
+}
+
+void killQueryPool( const VkDevice device, const VkQueryPool queryPool ){
+	PROFILE_FUNCTION();
+	vkDestroyQueryPool( device, queryPool, nullptr );
+}
+
+bool getQueryResults( const VkDevice device, const VkQueryPool queryPool, const uint32_t firstQuery, const uint32_t count, uint64_t* const results, const uint32_t valuesPerQuery ){
+	const VkDeviceSize stride = valuesPerQuery * sizeof( uint64_t );
+	const VkResult errorCode = vkGetQueryPoolResults(
+		device, queryPool, firstQuery, count,
+		static_cast<size_t>( count * stride ), results, stride, // data size, data, stride
+		VK_QUERY_RESULT_64_BIT // no VK_QUERY_RESULT_WAIT_BIT
+	);
+	if( errorCode == VK_NOT_READY ) return false;
+	RESULT_HANDLER( errorCode, "vkGetQueryPoolResults" );
+
+	return true;
+}
+
 void acquireCommandBuffers( VkDevice device, VkCommandPool commandPool, uint32_t count, vector<VkCommandBuffer>& commandBuffers ){
 	const auto oldSize = static_cast<uint32_t>( commandBuffers.size() );
 
@@ -1813,20 +3554,21 @@ void acquireCommandBuffers( VkDevice device, VkCommandPool commandPool, uint32_t
 
 		commandBuffers.resize( count );
 		VkResult errorCode = vkAllocateCommandBuffers( device, &commandBufferInfo, &commandBuffers[oldSize] ); RESULT_HANDLER( errorCode, "vkAllocateCommandBuffers" );
+		registerCommandBuffers( device, count - oldSize, &commandBuffers[oldSize] );
 	}
 
 	if( count < oldSize ) {
+		unregisterCommandBuffers( oldSize - count, &commandBuffers[count] );
 		vkFreeCommandBuffers( device, commandPool, oldSize - count, &commandBuffers[count] );
 		commandBuffers.resize( count );
 	}
 }
 
-void beginCommandBuffer( VkCommandBuffer commandBuffer ){
+void beginCommandBuffer( VkCommandBuffer commandBuffer, const VkCommandBufferUsageFlags usage ){
 	VkCommandBufferBeginInfo commandBufferInfo{
 		VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
 		nullptr, // pNext
-		// same buffer can be re-executed before it finishes from last submit
-		VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT, // flags
+		usage, // flags
 		nullptr // inheritance
 	};
 
@@ -1862,38 +3604,162 @@ void recordEndRenderPass( VkCommandBuffer commandBuffer ){
 	vkCmdEndRenderPass( commandBuffer );
 }
 
+void recordResetQueries( const VkCommandBuffer commandBuffer, const VkQueryPool queryPool, const uint32_t firstQuery, const uint32_t count ){
+	vkCmdResetQueryPool( commandBuffer, queryPool, firstQuery, count );
+}
+
+void recordWriteTimestamp( const VkCommandBuffer commandBuffer, const VkPipelineStageFlagBits stage, const VkQueryPool queryPool, const uint32_t query ){
+	vkCmdWriteTimestamp( commandBuffer, stage, queryPool, query );
+}
+
+void recordBeginQuery( const VkCommandBuffer commandBuffer, const VkQueryPool queryPool, const uint32_t query ){
+	vkCmdBeginQuery( commandBuffer, queryPool, query, 0 /*flags*/ );
+}
+
+void recordEndQuery( const VkCommandBuffer commandBuffer, const VkQueryPool queryPool, const uint32_t query ){
+	vkCmdEndQuery( commandBuffer, queryPool, query );
+}
+
 void recordBindPipeline( VkCommandBuffer commandBuffer, VkPipeline pipeline ){
 	vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline );
 }
 
-void recordBindVertexBuffer( VkCommandBuffer commandBuffer, const uint32_t vertexBufferBinding, VkBuffer vertexBuffer ){
-	VkDeviceSize offsets[] = {0};
+void recordSetViewport( VkCommandBuffer commandBuffer, const uint32_t width, const uint32_t height ){
+	const VkViewport viewport{
+		0.0f, // x
+		0.0f, // y
+		static_cast<float>( width ? width : 1 ),
+		static_cast<float>( height ? height : 1 ),
+		0.0f, // min depth
+		1.0f // max depth
+	};
+	vkCmdSetViewport( commandBuffer, 0 /*first viewport*/, 1 /*viewport count*/, &viewport );
+
+	const VkRect2D scissor{
+		{0, 0}, // offset
+		{width, height}
+	};
+	vkCmdSetScissor( commandBuffer, 0 /*first scissor*/, 1 /*scissor count*/, &scissor );
+}
+
+void recordBindVertexBuffer( VkCommandBuffer commandBuffer, const uint32_t vertexBufferBinding, VkBuffer vertexBuffer, const VkDeviceSize offset ){
+	VkDeviceSize offsets[] = {offset};
 	vkCmdBindVertexBuffers( commandBuffer, vertexBufferBinding, 1 /*binding count*/, &vertexBuffer, offsets );
 }
 
-void recordDraw( VkCommandBuffer commandBuffer, const uint32_t vertexCount ){
-	vkCmdDraw( commandBuffer, vertexCount, 1 /*instance count*/, 0 /*first vertex*/, 0 /*first instance*/ );
+void recordBindIndexBuffer( VkCommandBuffer commandBuffer, VkBuffer indexBuffer, const VkIndexType indexType ){
+	vkCmdBindIndexBuffer( commandBuffer, indexBuffer, 0 /*offset*/, indexType );
+}
+
+void recordDraw( VkCommandBuffer commandBuffer, const uint32_t vertexCount, const uint32_t instanceCount ){
+	vkCmdDraw( commandBuffer, vertexCount, instanceCount, 0 /*first vertex*/, 0 /*first instance*/ );
+}
+
+void recordDrawIndexed( VkCommandBuffer commandBuffer, const uint32_t indexCount, const uint32_t instanceCount ){
+	vkCmdDrawIndexed( commandBuffer, indexCount, instanceCount, 0 /*first index*/, 0 /*vertex offset*/, 0 /*first instance*/ );
+}
+
+void recordFillBuffer( const VkCommandBuffer commandBuffer, const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t value ){
+	vkCmdFillBuffer( commandBuffer, buffer, offset, size, value );
+}
+
+void recordCopyBuffer( const VkCommandBuffer commandBuffer, const VkBuffer source, const VkDeviceSize sourceOffset, const VkBuffer destination, const VkDeviceSize destinationOffset, const VkDeviceSize size ){
+	const VkBufferCopy region{ sourceOffset, destinationOffset, size };
+	vkCmdCopyBuffer( commandBuffer, source, destination, 1, &region );
+}
+
+void recordMemoryBarrier( const VkCommandBuffer commandBuffer, const VkPipelineStageFlags srcStages, const VkAccessFlags srcAccess, const VkPipelineStageFlags dstStages, const VkAccessFlags dstAccess ){
+	const VkMemoryBarrier barrier{
+		VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		nullptr, // pNext
+		srcAccess,
+		dstAccess
+	};
+	vkCmdPipelineBarrier( commandBuffer, srcStages, dstStages, 0 /*dependency flags*/, 1, &barrier, 0, nullptr, 0, nullptr );
+}
+
+void recordBindComputeDescriptorSet( const VkCommandBuffer commandBuffer, const VkPipelineLayout pipelineLayout, const VkDescriptorSet descriptorSet, const uint32_t dynamicOffsetCount, const uint32_t* const dynamicOffsets ){
+	vkCmdBindDescriptorSets(
+		commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0 /*first set*/, 1, &descriptorSet,
+		dynamicOffsetCount, dynamicOffsets
+	);
+}
+
+void recordDispatch( const VkCommandBuffer commandBuffer, const VkPipeline pipeline, const VkPipelineLayout pipelineLayout, const void* const pushConstants, const uint32_t pushConstantsSize, const uint32_t itemCount, const uint32_t maxWorkgroupCountX ){
+	vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline );
+	vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0 /*offset*/, pushConstantsSize, pushConstants );
+
+	// the invocations past itemCount in the last row return early
+	const uint32_t workgroupCount = (itemCount + computeWorkgroupSize - 1) / computeWorkgroupSize;
+	const uint32_t rowWidth = std::max( std::min( workgroupCount, maxWorkgroupCountX ), 1u );
+	vkCmdDispatch( commandBuffer, rowWidth, (workgroupCount + rowWidth - 1) / rowWidth, 1 );
+}
+
+void recordDrawIndirect(
+	const VkCommandBuffer commandBuffer, const VkBuffer buffer, const VkDeviceSize offset, const uint32_t maxDrawCount, const uint32_t stride, const bool indexed,
+	const VkBuffer countBuffer, const VkDeviceSize countOffset
+){
+	if( countBuffer ){
+		if( indexed ) vkCmdDrawIndexedIndirectCountKHR( commandBuffer, buffer, offset, countBuffer, countOffset, maxDrawCount, stride );
+		else vkCmdDrawIndirectCountKHR( commandBuffer, buffer, offset, countBuffer, countOffset, maxDrawCount, stride );
+	}
+	else{
+		if( indexed ) vkCmdDrawIndexedIndirect( commandBuffer, buffer, offset, maxDrawCount, stride );
+		else vkCmdDrawIndirect( commandBuffer, buffer, offset, maxDrawCount, stride );
+	}
 }
 
-void submitToQueue( VkQueue queue, VkCommandBuffer commandBuffer, VkSemaphore imageReadyS, VkSemaphore renderDoneS, VkFence fence ){
+void submitToQueue(
+	VkQueue queue,
+	VkCommandBuffer commandBuffer,
+	VkSemaphore imageReadyS,
+	VkSemaphore renderDoneS,
+	VkFence fence,
+	VkSemaphore timelineS, uint64_t timelineValue
+){
 	const VkPipelineStageFlags psw = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
+	VkSemaphore signalSemaphores[2];
+	uint64_t signalValues[2];
+	uint32_t signalCount = 0;
+	if( renderDoneS ){
+		signalSemaphores[signalCount] = renderDoneS;
+		signalValues[signalCount++] = 0; // ignored for binary semaphore
+	}
+	if( timelineS ){
+		signalSemaphores[signalCount] = timelineS;
+		signalValues[signalCount++] = timelineValue;
+	}
+
+	const VkTimelineSemaphoreSubmitInfoKHR timelineInfo{
+		VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		nullptr, // pNext
+		0, nullptr, // wait values -- only binary semaphore is waited on
+		signalCount, signalValues
+	};
+
 	const VkSubmitInfo submit{
 		VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		nullptr, // pNext
-		1, &imageReadyS, // wait semaphores
+		timelineS ? &timelineInfo : nullptr, // pNext
+		imageReadyS ? 1u : 0u, &imageReadyS, // wait semaphores
 		&psw, // pipeline stages to wait for semaphore
 		1, &commandBuffer,
-		1, &renderDoneS // signal semaphores
+		signalCount, signalSemaphores // signal semaphores
 	};
 
 	const VkResult errorCode = vkQueueSubmit( queue, 1 /*submit count*/, &submit, fence ); RESULT_HANDLER( errorCode, "vkQueueSubmit" );
 }
 
-void present( VkQueue queue, VkSwapchainKHR swapchain, uint32_t swapchainImageIndex, VkSemaphore renderDoneS ){
+void present( VkQueue queue, VkSwapchainKHR swapchain, uint32_t swapchainImageIndex, VkSemaphore renderDoneS, const VkFence presentFence ){
+	const VkSwapchainPresentFenceInfoEXT presentFenceInfo{
+		VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT,
+		nullptr, // pNext
+		1, &presentFence // swapchainCount, pFences
+	};
+
 	const VkPresentInfoKHR presentInfo{
 		VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-		nullptr, // pNext
+		presentFence ? &presentFenceInfo : nullptr, // pNext
 		1, &renderDoneS, // wait semaphores
 		1, &swapchain, &swapchainImageIndex,
 		nullptr // pResults
@@ -0,0 +1,100 @@
+// Copies from the host into mapped device memory
+//
+// HOST_VISIBLE memory without HOST_CACHED is usually write-combined: the CPU
+// collects the writes in line sized buffers and sends them over the bus, and
+// reading it back is extremely slow. Such memory is best written sequentially
+// by whole lines, which the non-temporal (streaming) stores do. They also keep
+// big copies into cached memory from evicting the rest of the CPU cache.
+// Memory without HOST_COHERENT additionally needs vkFlushMappedMemoryRanges
+// after the writes; see DeviceMemoryAllocator::flush.
+// The SIMD path is chosen at compile time: AVX when the compiler targets it
+// (e.g. -march=native or /arch:AVX2), SSE2 on any x86-64, plain memcpy otherwise.
+
+#ifndef COMMON_HOST_UPLOAD_H
+#define COMMON_HOST_UPLOAD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <vulkan/vulkan.h>
+
+#if defined( __AVX__ )
+	#include <immintrin.h>
+	#define HOST_UPLOAD_AVX
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+	#include <emmintrin.h>
+	#define HOST_UPLOAD_SSE2
+#endif
+
+
+// copies at least this big bypass the cache even for HOST_CACHED memory
+constexpr size_t nonTemporalCopyThreshold = 256 * 1024;
+
+inline bool isWriteCombined( const VkMemoryPropertyFlags flags ){
+	return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+}
+
+inline bool needsFlush( const VkMemoryPropertyFlags flags ){
+	return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+inline const char* hostMemoryKindString( const VkMemoryPropertyFlags flags ){
+	if( isWriteCombined( flags ) ) return needsFlush( flags ) ? "write-combined non-coherent" : "write-combined";
+	else return needsFlush( flags ) ? "cached non-coherent" : "cached";
+}
+
+inline const char* nonTemporalCopyIsa(){
+#if defined( HOST_UPLOAD_AVX )
+	return "AVX";
+#elif defined( HOST_UPLOAD_SSE2 )
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+// memcpy with non-temporal stores; the writes are fenced before returning
+inline void copyNonTemporal( void* destination, const void* source, size_t size ){
+#if defined( HOST_UPLOAD_AVX ) || defined( HOST_UPLOAD_SSE2 )
+	#if defined( HOST_UPLOAD_AVX )
+		using Vector = __m256i;
+		const auto load = []( const unsigned char* p ){ return _mm256_loadu_si256( reinterpret_cast<const __m256i*>( p ) ); };
+		const auto stream = []( unsigned char* p, const __m256i v ){ _mm256_stream_si256( reinterpret_cast<__m256i*>( p ), v ); };
+	#else
+		using Vector = __m128i;
+		const auto load = []( const unsigned char* p ){ return _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) ); };
+		const auto stream = []( unsigned char* p, const __m128i v ){ _mm_stream_si128( reinterpret_cast<__m128i*>( p ), v ); };
+	#endif
+	constexpr size_t vectorSize = sizeof( Vector );
+	constexpr size_t lineSize = 64; // unrolled so each iteration fills a whole write-combining buffer
+
+	unsigned char* dst = static_cast<unsigned char*>( destination );
+	const unsigned char* src = static_cast<const unsigned char*>( source );
+
+	// streaming stores need an aligned destination
+	const size_t head = std::min(  size, ( vectorSize - reinterpret_cast<uintptr_t>( dst ) % vectorSize ) % vectorSize  );
+	std::memcpy( dst, src, head );
+	dst += head; src += head; size -= head;
+
+	for( ; size >= lineSize; dst += lineSize, src += lineSize, size -= lineSize ){
+		Vector v[lineSize / vectorSize];
+		for( size_t i = 0; i < lineSize / vectorSize; ++i ) v[i] = load( src + i * vectorSize );
+		for( size_t i = 0; i < lineSize / vectorSize; ++i ) stream( dst + i * vectorSize, v[i] );
+	}
+	for( ; size >= vectorSize; dst += vectorSize, src += vectorSize, size -= vectorSize ) stream( dst, load( src ) );
+
+	std::memcpy( dst, src, size );
+	_mm_sfence(); // streaming stores are weakly ordered
+#else
+	std::memcpy( destination, source, size );
+#endif
+}
+
+// picks the copy for the memory type; flushing non-coherent memory is up to the caller
+inline void copyToHostMemory( void* destination, const void* source, const size_t size, const VkMemoryPropertyFlags memoryFlags ){
+	if( isWriteCombined( memoryFlags ) || size >= nonTemporalCopyThreshold ) copyNonTemporal( destination, source, size );
+	else std::memcpy( destination, source, size );
+}
+
+#endif //COMMON_HOST_UPLOAD_H
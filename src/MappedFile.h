@@ -0,0 +1,170 @@
+// Read-only memory mapped files and atomic file replacement
+//
+// Only what the app needs to persist binary blobs (e.g. pipeline cache, meshes)
+// between runs without copying them through iostreams first.
+
+#ifndef COMMON_MAPPED_FILE_H
+#define COMMON_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+	// the min/max macros would break std::min/std::max in the headers included after this one
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <Windows.h>
+	#include <io.h>
+	#include <process.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+// whole file mapped read-only
+// a file that does not exist (or cannot be mapped) results in an empty mapping; that is not an error
+class MappedFile{
+	const void* mapping = nullptr;
+	size_t mappingSize = 0;
+
+	public:
+	MappedFile() = default;
+
+	explicit MappedFile( const std::string& filename ){
+#ifdef _WIN32
+		const HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+		if( file == INVALID_HANDLE_VALUE ) return;
+
+		LARGE_INTEGER fileSize;
+		if( GetFileSizeEx( file, &fileSize ) && fileSize.QuadPart > 0 ){
+			const HANDLE fileMapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+			if( fileMapping ){
+				mapping = MapViewOfFile( fileMapping, FILE_MAP_READ, 0, 0, 0 );
+				if( mapping ) mappingSize = static_cast<size_t>( fileSize.QuadPart );
+				CloseHandle( fileMapping ); // view keeps the mapping alive
+			}
+		}
+		CloseHandle( file );
+#else
+		const int fd = open( filename.c_str(), O_RDONLY );
+		if( fd == -1 ) return;
+
+		struct stat fileStat;
+		if( fstat( fd, &fileStat ) == 0 && fileStat.st_size > 0 ){
+			void* const m = mmap( nullptr, static_cast<size_t>( fileStat.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+			if( m != MAP_FAILED ){
+				mapping = m;
+				mappingSize = static_cast<size_t>( fileStat.st_size );
+			}
+		}
+		close( fd ); // mapping stays valid
+#endif
+	}
+
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile& operator=( const MappedFile& ) = delete;
+
+	MappedFile( MappedFile&& other ) noexcept
+	: mapping( other.mapping ), mappingSize( other.mappingSize )
+	{
+		other.mapping = nullptr;
+		other.mappingSize = 0;
+	}
+
+	MappedFile& operator=( MappedFile&& other ) noexcept{
+		std::swap( mapping, other.mapping );
+		std::swap( mappingSize, other.mappingSize );
+		return *this;
+	}
+
+	~MappedFile(){ unmap(); }
+
+	void unmap(){
+		if( !mapping ) return;
+#ifdef _WIN32
+		UnmapViewOfFile( mapping );
+#else
+		munmap( const_cast<void*>( mapping ), mappingSize );
+#endif
+		mapping = nullptr;
+		mappingSize = 0;
+	}
+
+	// the pages of the range are dropped from memory; touching them again reads them from the file anew
+	// keeps the resident memory bounded when streaming through a file bigger than RAM
+	void release( const size_t offset, const size_t size ) const{
+		if( !mapping || !size ) return;
+#ifdef _WIN32
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo( &systemInfo );
+		const size_t pageSize = systemInfo.dwPageSize;
+#else
+		const size_t pageSize = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+#endif
+		const uintptr_t begin = reinterpret_cast<uintptr_t>( mapping ) + offset;
+		const uintptr_t alignedBegin = begin / pageSize * pageSize; // pages only partially in the range are dropped too; that is harmless for a read-only mapping
+#ifdef _WIN32
+		VirtualUnlock( reinterpret_cast<void*>( alignedBegin ), begin + size - alignedBegin ); // fails as nothing is locked, but trims the pages from the working set anyway
+#else
+		madvise( reinterpret_cast<void*>( alignedBegin ), begin + size - alignedBegin, MADV_DONTNEED );
+#endif
+	}
+
+	const void* data() const{ return mapping; }
+	size_t size() const{ return mappingSize; }
+	bool empty() const{ return mappingSize == 0; }
+};
+
+// writes the data into a temporary file next to the target first and then renames it over the target
+// so readers (including other instances of the app) see either the old or the new file, never a partial one
+// the temporary file is per process, so instances writing at the same time do not mix their content,
+// and it is on the disk before the rename, so a crash cannot leave a renamed but empty file behind
+// write streams the content into the file and returns false on failure
+// returns false on failure; the target file is left untouched then
+inline bool writeFileAtomically( const std::string& filename, const std::function<bool( std::FILE* )>& write ){
+#ifdef _WIN32
+	const std::string tempFilename = filename + "." + std::to_string( _getpid() ) + ".tmp";
+#else
+	const std::string tempFilename = filename + "." + std::to_string( getpid() ) + ".tmp";
+#endif
+
+	std::FILE* const file = std::fopen( tempFilename.c_str(), "wb" );
+	if( !file ) return false;
+
+	bool written = write( file ) && std::fflush( file ) == 0;
+#ifdef _WIN32
+	written = written && FlushFileBuffers(  reinterpret_cast<HANDLE>( _get_osfhandle( _fileno( file ) ) )  ) != 0;
+#else
+	written = written && fsync( fileno( file ) ) == 0;
+#endif
+	const bool closed = std::fclose( file ) == 0;
+	if( !written || !closed ){
+		std::remove( tempFilename.c_str() );
+		return false;
+	}
+
+#ifdef _WIN32
+	const bool renamed = MoveFileExA( tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) != 0;
+#else
+	const bool renamed = std::rename( tempFilename.c_str(), filename.c_str() ) == 0;
+#endif
+	if( !renamed ) std::remove( tempFilename.c_str() );
+
+	return renamed;
+}
+
+inline bool writeFileAtomically( const std::string& filename, const void* data, size_t size ){
+	return writeFileAtomically(  filename, [=]( std::FILE* file ){ return std::fwrite( data, 1, size, file ) == size; }  );
+}
+
+#endif //COMMON_MAPPED_FILE_H
@@ -0,0 +1,328 @@
+// Sub-allocation of resources from big VkDeviceMemory blocks
+//
+// vkAllocateMemory is slow and the number of live allocations is limited by
+// maxMemoryAllocationCount, so memory is allocated in big blocks per memory type,
+// and the resources are placed into them by a buddy allocator.
+// Buddy nodes are aligned to their (power of two) size, so any alignment up to the
+// node size comes for free. Linear (buffers) and non-linear (optimal images)
+// resources never share a block, so bufferImageGranularity cannot be violated.
+// Resources the driver prefers or requires to be dedicated (VK_KHR_dedicated_allocation)
+// get their own VkDeviceMemory via allocateDedicated.
+
+#ifndef COMMON_MEMORY_ALLOCATOR_H
+#define COMMON_MEMORY_ALLOCATOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "ErrorHandling.h"
+
+
+// Placement of power of two sized nodes inside a range of [0, size)
+// Knows nothing about Vulkan; just the offsets.
+class BuddyAllocator{
+	uint64_t size; // power of two
+	uint64_t minNodeSize; // power of two
+	std::vector< std::set<uint64_t> > freeNodes; // offsets of free nodes per level; level 0 is the whole range
+	std::unordered_map<uint64_t, uint32_t> usedNodes; // offset -> level
+	uint64_t usedBytes = 0; // including the internal fragmentation of the nodes
+
+	static bool isPowerOfTwo( const uint64_t x ){ return x && !(x & (x - 1)); }
+
+	uint64_t nodeSize( const uint32_t level ) const{ return size >> level; }
+
+	public:
+	static const uint64_t allocationFailed = UINT64_MAX;
+
+	BuddyAllocator( const uint64_t size, const uint64_t minNodeSize ) : size( size ), minNodeSize( minNodeSize ){
+		assert( isPowerOfTwo( size ) && isPowerOfTwo( minNodeSize ) && minNodeSize <= size );
+
+		uint32_t levels = 1;
+		while( nodeSize( levels - 1 ) > minNodeSize ) ++levels;
+		freeNodes.resize( levels );
+		freeNodes[0].insert( 0 );
+	}
+
+	// returns the offset, or allocationFailed if there is no free node big enough
+	// alignment must be a power of two
+	uint64_t allocate( const uint64_t requestedSize, const uint64_t alignment ){
+		uint64_t needed = std::max( std::max( requestedSize, alignment ), minNodeSize );
+		if( needed > size ) return allocationFailed;
+
+		uint32_t level = static_cast<uint32_t>( freeNodes.size() ) - 1;
+		while( nodeSize( level ) < needed ) --level;
+
+		// smallest free node that is big enough
+		uint32_t freeLevel = level;
+		while( freeNodes[freeLevel].empty() ){
+			if( freeLevel == 0 ) return allocationFailed;
+			--freeLevel;
+		}
+
+		const uint64_t offset = *freeNodes[freeLevel].begin();
+		freeNodes[freeLevel].erase( freeNodes[freeLevel].begin() );
+
+		// split it down to the needed size; the right halves stay free
+		for( ; freeLevel < level; ++freeLevel ) freeNodes[freeLevel + 1].insert( offset + nodeSize( freeLevel + 1 ) );
+
+		usedNodes[offset] = level;
+		usedBytes += nodeSize( level );
+		return offset;
+	}
+
+	void free( uint64_t offset ){
+		const auto used = usedNodes.find( offset );
+		assert( used != usedNodes.end() );
+		uint32_t level = used->second;
+		usedNodes.erase( used );
+		usedBytes -= nodeSize( level );
+
+		// merge with the buddy as long as it is free too
+		for( ; level > 0; --level ){
+			const uint64_t buddy = offset ^ nodeSize( level );
+			const auto freeBuddy = freeNodes[level].find( buddy );
+			if( freeBuddy == freeNodes[level].end() ) break;
+
+			freeNodes[level].erase( freeBuddy );
+			offset = std::min( offset, buddy );
+		}
+		freeNodes[level].insert( offset );
+	}
+
+	bool empty() const{ return usedNodes.empty(); }
+	size_t allocationCount() const{ return usedNodes.size(); }
+	uint64_t capacity() const{ return size; }
+	uint64_t used() const{ return usedBytes; }
+
+	uint64_t largestFreeNode() const{
+		for( uint32_t level = 0; level < freeNodes.size(); ++level ) if( !freeNodes[level].empty() ) return nodeSize( level );
+		return 0;
+	}
+};
+
+
+struct MemoryAllocation{
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size; // as requested
+	uint32_t block; // index into the allocator's blocks
+};
+
+struct MemoryHeapStats{
+	uint32_t blockCount;
+	uint32_t allocationCount;
+	VkDeviceSize allocatedBytes; // sum of the VkDeviceMemory sizes
+	VkDeviceSize usedBytes; // sum of the buddy nodes (i.e. including their internal fragmentation)
+	VkDeviceSize largestFreeRange;
+	double fragmentation; // 0 when all free memory is one range; approaches 1 when scattered into small pieces
+};
+
+class DeviceMemoryAllocator{
+	struct Block{
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		uint32_t memoryType;
+		bool linear;
+		std::unique_ptr<BuddyAllocator> placement; // NULL for a dedicated block holding just one resource (oversized, or dedicated by the driver's wish)
+		void* mapped; // persistent mapping of the whole block; NULL until map() is first called
+	};
+
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkDeviceSize blockSize;
+	uint32_t maxAllocationCount;
+	VkDeviceSize nonCoherentAtomSize;
+	bool dedicatedAllocationEnabled;
+
+	std::vector<Block> blocks; // killed blocks leave a NULL memory hole to keep the indices stable
+	uint32_t liveBlocks = 0;
+
+	// dedicatedInfo is chained into VkMemoryAllocateInfo; only for dedicated blocks
+	uint32_t initBlock( const VkDeviceSize size, const uint32_t memoryType, const bool linear, const bool dedicated, const void* const dedicatedInfo = nullptr ){
+		if( liveBlocks >= maxAllocationCount ) throw "Device memory allocation count would exceed maxMemoryAllocationCount!";
+
+		const VkMemoryAllocateInfo memoryInfo{
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			dedicatedInfo, // pNext
+			size,
+			memoryType
+		};
+
+		VkDeviceMemory memory;
+		VkResult errorCode = vkAllocateMemory( device, &memoryInfo, nullptr, &memory ); RESULT_HANDLER( errorCode, "vkAllocateMemory" );
+		++liveBlocks;
+
+		Block block{ memory, size, memoryType, linear, dedicated ? nullptr : std::unique_ptr<BuddyAllocator>( new BuddyAllocator( size, minNodeSize ) ), nullptr };
+
+		for( uint32_t i = 0; i < blocks.size(); ++i ){
+			if( !blocks[i].memory ){
+				blocks[i] = std::move( block );
+				return i;
+			}
+		}
+		blocks.push_back( std::move( block ) );
+		return static_cast<uint32_t>( blocks.size() - 1 );
+	}
+
+	void killBlock( Block& block ){
+		if( block.mapped ) vkUnmapMemory( device, block.memory );
+		vkFreeMemory( device, block.memory, nullptr );
+		block = Block{ VK_NULL_HANDLE, 0, 0, false, nullptr, nullptr };
+		--liveBlocks;
+	}
+
+	std::vector<MemoryHeapStats> collectStats( const bool perHeap ) const{
+		const uint32_t count = perHeap ? memoryProperties.memoryHeapCount : memoryProperties.memoryTypeCount;
+		std::vector<MemoryHeapStats> stats( count, MemoryHeapStats{ 0, 0, 0, 0, 0, 0.0 } );
+		std::vector<VkDeviceSize> freeBytes( count, 0 );
+
+		for( const auto& block : blocks ){
+			if( !block.memory ) continue;
+
+			const uint32_t index = perHeap ? memoryProperties.memoryTypes[block.memoryType].heapIndex : block.memoryType;
+			MemoryHeapStats& s = stats[index];
+			++s.blockCount;
+			s.allocatedBytes += block.size;
+
+			if( block.placement ){
+				s.allocationCount += static_cast<uint32_t>( block.placement->allocationCount() );
+				s.usedBytes += block.placement->used();
+				s.largestFreeRange = std::max( s.largestFreeRange, block.placement->largestFreeNode() );
+				freeBytes[index] += block.size - block.placement->used();
+			}
+			else{ // dedicated; fully used
+				++s.allocationCount;
+				s.usedBytes += block.size;
+			}
+		}
+
+		for( uint32_t i = 0; i < count; ++i ){
+			if( freeBytes[i] ) stats[i].fragmentation = 1.0 - static_cast<double>( stats[i].largestFreeRange ) / static_cast<double>( freeBytes[i] );
+		}
+
+		return stats;
+	}
+
+	public:
+	static const VkDeviceSize minNodeSize = 256;
+
+	// blockSize must be a power of two; resources bigger than half of it get a dedicated block
+	// dedicatedAllocationEnabled means VK_KHR_dedicated_allocation (and VK_KHR_get_memory_requirements2) is enabled on the device
+	DeviceMemoryAllocator(
+		const VkDevice device,
+		const VkPhysicalDeviceMemoryProperties& memoryProperties,
+		const VkPhysicalDeviceLimits& limits,
+		const VkDeviceSize blockSize,
+		const bool dedicatedAllocationEnabled = false
+	)
+	: device( device ), memoryProperties( memoryProperties ), blockSize( blockSize ), maxAllocationCount( limits.maxMemoryAllocationCount ), nonCoherentAtomSize( limits.nonCoherentAtomSize ), dedicatedAllocationEnabled( dedicatedAllocationEnabled ){
+		assert( blockSize >= minNodeSize && !(blockSize & (blockSize - 1)) );
+	}
+
+	DeviceMemoryAllocator( const DeviceMemoryAllocator& ) = delete;
+	DeviceMemoryAllocator& operator=( const DeviceMemoryAllocator& ) = delete;
+
+	const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const{ return memoryProperties; }
+	bool isDedicatedAllocationEnabled() const{ return dedicatedAllocationEnabled; }
+
+	VkMemoryPropertyFlags getMemoryPropertyFlags( const MemoryAllocation& allocation ) const{
+		return memoryProperties.memoryTypes[blocks[allocation.block].memoryType].propertyFlags;
+	}
+
+	// linear is true for buffers and linear images, false for optimal images
+	MemoryAllocation allocate( const VkMemoryRequirements& requirements, const uint32_t memoryType, const bool linear ){
+		if( requirements.size > blockSize / 2 ){
+			const uint32_t block = initBlock( requirements.size, memoryType, linear, true );
+			return { blocks[block].memory, 0, requirements.size, block };
+		}
+
+		for( uint32_t i = 0; i < blocks.size(); ++i ){
+			Block& block = blocks[i];
+			if( !block.memory || !block.placement || block.memoryType != memoryType || block.linear != linear ) continue;
+
+			const uint64_t offset = block.placement->allocate( requirements.size, requirements.alignment );
+			if( offset != BuddyAllocator::allocationFailed ) return { block.memory, offset, requirements.size, i };
+		}
+
+		const uint32_t block = initBlock( blockSize, memoryType, linear, false );
+		const uint64_t offset = blocks[block].placement->allocate( requirements.size, requirements.alignment );
+		assert( offset != BuddyAllocator::allocationFailed );
+		return { blocks[block].memory, offset, requirements.size, block };
+	}
+
+	// own VkDeviceMemory just for the resource, which the driver prefers or requires
+	// dedicatedInfo is the VkMemoryDedicatedAllocateInfo naming the resource
+	MemoryAllocation allocateDedicated( const VkMemoryRequirements& requirements, const uint32_t memoryType, const bool linear, const VkMemoryDedicatedAllocateInfoKHR& dedicatedInfo ){
+		assert( dedicatedAllocationEnabled );
+		const uint32_t block = initBlock( requirements.size, memoryType, linear, true, &dedicatedInfo );
+		return { blocks[block].memory, 0, requirements.size, block };
+	}
+
+	// empty blocks are killed right away
+	void free( const MemoryAllocation& allocation ){
+		Block& block = blocks[allocation.block];
+		assert( block.memory == allocation.memory );
+
+		if( block.placement ) block.placement->free( allocation.offset );
+		if( !block.placement || block.placement->empty() ) killBlock( block );
+	}
+
+	// host pointer to the allocation; the memory type has to be HOST_VISIBLE
+	// blocks stay mapped until killed, so any number of allocations can be mapped at once
+	void* map( const MemoryAllocation& allocation ){
+		Block& block = blocks[allocation.block];
+		if( !block.mapped ){
+			VkResult errorCode = vkMapMemory( device, block.memory, 0 /*offset*/, VK_WHOLE_SIZE, 0 /*flags - reserved*/, &block.mapped ); RESULT_HANDLER( errorCode, "vkMapMemory" );
+		}
+		return static_cast<unsigned char*>( block.mapped ) + allocation.offset;
+	}
+
+	// makes host writes to [offset, offset + size) of the allocation visible to the device; no-op for HOST_COHERENT memory
+	// the range is widened to nonCoherentAtomSize, which is harmless as the whole block is mapped
+	void flush( const MemoryAllocation& allocation, const VkDeviceSize offset, const VkDeviceSize size ){
+		const Block& block = blocks[allocation.block];
+		assert( block.mapped && offset + size <= allocation.size );
+		if( memoryProperties.memoryTypes[block.memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ) return;
+
+		const VkDeviceSize begin = (allocation.offset + offset) / nonCoherentAtomSize * nonCoherentAtomSize;
+		const VkDeviceSize end = std::min( (allocation.offset + offset + size + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, block.size );
+
+		const VkMappedMemoryRange range{
+			VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+			nullptr, // pNext
+			block.memory,
+			begin,
+			end - begin
+		};
+		VkResult errorCode = vkFlushMappedMemoryRanges( device, 1, &range ); RESULT_HANDLER( errorCode, "vkFlushMappedMemoryRanges" );
+	}
+
+	// per memory heap
+	std::vector<MemoryHeapStats> getHeapStats() const{ return collectStats( true ); }
+	// per memory type; same as getHeapStats, but not merged per heap
+	std::vector<MemoryHeapStats> getMemoryTypeStats() const{ return collectStats( false ); }
+
+	// frees everything; warns about what was not freed by the app
+	// must be called before the device is killed
+	void kill(){
+		uint32_t leaked = 0;
+		for( auto& block : blocks ){
+			if( !block.memory ) continue;
+			leaked += block.placement ? static_cast<uint32_t>( block.placement->allocationCount() ) : 1;
+			killBlock( block );
+		}
+		blocks.clear();
+
+		if( leaked ) logger << "WARNING: " << leaked << " device memory allocation(s) were not freed before the allocator was killed." << std::endl;
+	}
+};
+
+#endif //COMMON_MEMORY_ALLOCATOR_H
@@ -0,0 +1,100 @@
+// Device memory budget and usage per heap
+//
+// VK_EXT_memory_budget reports how much memory the process uses per heap and
+// how much it can use before hurting itself or other processes (the budget
+// changes at runtime as the other processes allocate). Without the extension
+// the budget is estimated from the heap size and only the app's own
+// allocations are counted.
+// The app's own allocations come from the DeviceMemoryAllocator, per heap and
+// per memory type. A warning is logged when a heap goes over warningRatio of
+// its budget; isNearBudget lets the allocation policy react.
+
+#ifndef COMMON_MEMORY_TELEMETRY_H
+#define COMMON_MEMORY_TELEMETRY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "ErrorHandling.h"
+#include "ExtensionLoader.h"
+#include "MemoryAllocator.h"
+
+
+struct HeapTelemetry{
+	VkDeviceSize size;
+	VkDeviceSize budget;
+	VkDeviceSize usage; // of the whole process; the app's own allocations without VK_EXT_memory_budget
+	VkDeviceSize peakUsage;
+	VkDeviceSize appAllocatedBytes; // VkDeviceMemory allocated by the DeviceMemoryAllocator
+	VkDeviceSize appUsedBytes; // of that, placed resources
+};
+
+class MemoryTelemetry{
+	VkPhysicalDevice physicalDevice;
+	bool budgetSupported;
+	double warningRatio;
+
+	std::vector<HeapTelemetry> heaps;
+	std::vector<MemoryHeapStats> memoryTypes; // the app's own allocations
+	std::vector<bool> overWarning; // so each crossing of the warning level is logged once
+
+	static constexpr double estimatedBudgetRatio = 0.8; // of the heap size, without VK_EXT_memory_budget
+
+	public:
+	// budgetSupported requires VK_EXT_memory_budget enabled on the device and VK_KHR_get_physical_device_properties2 on the instance
+	MemoryTelemetry( const VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties& memoryProperties, const bool budgetSupported, const double warningRatio )
+	: physicalDevice( physicalDevice ), budgetSupported( budgetSupported ), warningRatio( warningRatio ), overWarning( memoryProperties.memoryHeapCount, false ){
+		for( uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; ++heap ){
+			const VkDeviceSize size = memoryProperties.memoryHeaps[heap].size;
+			heaps.push_back(  { size, static_cast<VkDeviceSize>( estimatedBudgetRatio * static_cast<double>( size ) ), 0, 0, 0, 0 }  );
+		}
+	}
+
+	bool isBudgetSupported() const{ return budgetSupported; }
+
+	// cheap enough to call every few hundred frames
+	void sample( const DeviceMemoryAllocator& allocator ){
+		const std::vector<MemoryHeapStats> heapStats = allocator.getHeapStats();
+		memoryTypes = allocator.getMemoryTypeStats();
+
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT, nullptr, {}, {} };
+		if( budgetSupported ){
+			VkPhysicalDeviceMemoryProperties2 memoryProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, &budgetProperties, {} };
+			vkGetPhysicalDeviceMemoryProperties2KHR( physicalDevice, &memoryProperties );
+		}
+
+		for( uint32_t heap = 0; heap < heaps.size(); ++heap ){
+			HeapTelemetry& h = heaps[heap];
+			h.appAllocatedBytes = heapStats[heap].allocatedBytes;
+			h.appUsedBytes = heapStats[heap].usedBytes;
+			if( budgetSupported ){
+				h.budget = budgetProperties.heapBudget[heap];
+				h.usage = budgetProperties.heapUsage[heap];
+			}
+			else{
+				h.usage = h.appAllocatedBytes;
+			}
+			h.peakUsage = std::max( h.peakUsage, h.usage );
+
+			const bool near = isNearBudget( heap );
+			if( near && !overWarning[heap] ){
+				logger << "WARNING: Memory heap " << heap << " usage " << h.usage << " B is over " << 100.0 * warningRatio << " % of its " << h.budget << " B budget"
+				       << (budgetSupported ? "" : " (estimated)") << "." << std::endl;
+			}
+			overWarning[heap] = near;
+		}
+	}
+
+	// as of the last sample()
+	bool isNearBudget( const uint32_t heap ) const{
+		return heaps[heap].usage && static_cast<double>( heaps[heap].usage ) >= warningRatio * static_cast<double>( heaps[heap].budget );
+	}
+
+	const std::vector<HeapTelemetry>& getHeaps() const{ return heaps; }
+	const std::vector<MemoryHeapStats>& getMemoryTypes() const{ return memoryTypes; }
+};
+
+#endif //COMMON_MEMORY_TELEMETRY_H
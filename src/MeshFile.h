@@ -0,0 +1,203 @@
+// Versioned binary mesh container, read through a memory mapping
+//
+// Layout (little-endian):
+//   MeshFileHeader
+//   MeshFileChunk table (chunkCount entries at chunkTableOffset)
+//   vertex and index blobs, each starting at a multiple of meshFileAlignment
+// The vertices and the indices are each split into chunks, stored in order, so
+// a loader can stream one chunk at a time straight from the mapping and drop
+// its pages afterwards -- meshes bigger than RAM load with bounded memory.
+
+#ifndef COMMON_MESH_FILE_H
+#define COMMON_MESH_FILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Vertex.h"
+
+
+const char meshFileMagic[8] = { 'H', 'T', 'M', 'E', 'S', 'H', '\0', '\0' };
+constexpr uint32_t meshFileVersion = 1;
+constexpr uint64_t meshFileAlignment = 4096; // of the blobs; a page, so each chunk's pages can be released on their own
+constexpr uint64_t defaultMeshChunkSize = 16 * 1024 * 1024;
+
+enum class MeshChunkType : uint32_t{
+	Vertices = 1,
+	Indices = 2
+};
+
+struct MeshFileHeader{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize; // sizeof( MeshFileHeader ) of the version
+	uint32_t vertexLayout; // VertexLayout
+	uint32_t vertexStride; // bytes
+	uint32_t indexSize; // bytes: 2 or 4; 0 if not indexed
+	uint32_t chunkCount;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t chunkTableOffset;
+	uint64_t reserved;
+};
+static_assert( sizeof( MeshFileHeader ) == 64, "MeshFileHeader must have no padding." );
+
+struct MeshFileChunk{
+	uint32_t type; // MeshChunkType
+	uint32_t reserved;
+	uint64_t offset; // of the blob from the start of the file
+	uint64_t size; // bytes
+	uint64_t firstElement; // the first vertex or index in the chunk
+};
+static_assert( sizeof( MeshFileChunk ) == 32, "MeshFileChunk must have no padding." );
+
+// throws std::string if the file is missing or malformed
+class MeshFile{
+	MappedFile file;
+	const MeshFileHeader* header = nullptr;
+	const MeshFileChunk* chunks = nullptr;
+
+	const unsigned char* bytes() const{ return static_cast<const unsigned char*>( file.data() ); }
+
+	// sets up the pointers into the mapping as it goes
+	void parse( const std::string& filename ){
+		const auto malformed = [&]( const char* what ){ return "Mesh file " + filename + " is malformed: " + what + "!"; };
+
+		if( file.size() < sizeof( MeshFileHeader ) ) throw malformed( "too small for the header" );
+		header = reinterpret_cast<const MeshFileHeader*>( bytes() );
+		if( std::memcmp( header->magic, meshFileMagic, sizeof( meshFileMagic ) ) != 0 ) throw malformed( "not a mesh file" );
+		if( header->version != meshFileVersion ) throw "Mesh file " + filename + " has unsupported version " + std::to_string( header->version ) + "!";
+		if( header->headerSize != sizeof( MeshFileHeader ) ) throw malformed( "wrong header size" );
+		if( !header->vertexStride ) throw malformed( "zero vertex stride" );
+		if( header->indexSize != 0 && header->indexSize != 2 && header->indexSize != 4 ) throw malformed( "index size is not 0, 2 or 4" );
+		if( !header->indexSize && header->indexCount ) throw malformed( "indices without an index size" );
+
+		const uint64_t tableSize = uint64_t( header->chunkCount ) * sizeof( MeshFileChunk );
+		if( header->chunkTableOffset % alignof( MeshFileChunk ) || header->chunkTableOffset > file.size() || tableSize > file.size() - header->chunkTableOffset ){
+			throw malformed( "chunk table out of the file" );
+		}
+		chunks = reinterpret_cast<const MeshFileChunk*>( bytes() + header->chunkTableOffset );
+
+		// chunks of each type must follow each other without gaps
+		uint64_t nextVertex = 0;
+		uint64_t nextIndex = 0;
+		for( uint32_t i = 0; i < header->chunkCount; ++i ){
+			const MeshFileChunk& chunk = chunks[i];
+			if( chunk.offset % meshFileAlignment ) throw malformed( "misaligned chunk" );
+			if( chunk.offset > file.size() || chunk.size > file.size() - chunk.offset ) throw malformed( "chunk out of the file" );
+
+			const bool vertices = chunk.type == static_cast<uint32_t>( MeshChunkType::Vertices );
+			if( !vertices && chunk.type != static_cast<uint32_t>( MeshChunkType::Indices ) ) throw malformed( "unknown chunk type" );
+
+			const uint64_t elementSize = vertices ? header->vertexStride : header->indexSize;
+			uint64_t& next = vertices ? nextVertex : nextIndex;
+			if( !elementSize || chunk.size % elementSize || chunk.firstElement != next ) throw malformed( "chunks out of order" );
+			next += chunk.size / elementSize;
+		}
+		if( nextVertex != header->vertexCount || nextIndex != header->indexCount ) throw malformed( "chunks do not cover the vertex or index count" );
+	}
+
+	public:
+	MeshFile() = default;
+
+	explicit MeshFile( const std::string& filename ) : file( filename ){
+		if( file.empty() ) throw "Can't map mesh file " + filename + "!";
+		parse( filename );
+	}
+
+	bool empty() const{ return header == nullptr; }
+
+	const MeshFileHeader& getHeader() const{ return *header; }
+	uint32_t getChunkCount() const{ return header ? header->chunkCount : 0; }
+	const MeshFileChunk& getChunk( const uint32_t chunk ) const{ return chunks[chunk]; }
+	const void* getChunkData( const uint32_t chunk ) const{ return bytes() + chunks[chunk].offset; }
+
+	// whether all the indices of an index chunk refer to existing vertices
+	// not checked by the constructor, as that would read the whole file; check each chunk as it is consumed instead
+	bool chunkIndicesInRange( const uint32_t chunk ) const{
+		const MeshFileChunk& c = chunks[chunk];
+		if( c.type != static_cast<uint32_t>( MeshChunkType::Indices ) ) return true;
+
+		const uint64_t count = c.size / header->indexSize;
+		const void* const data = getChunkData( chunk );
+		if( header->indexSize == 2 ){
+			const uint16_t* const indices = static_cast<const uint16_t*>( data );
+			return std::all_of( indices, indices + count, [this]( const uint16_t index ){ return index < header->vertexCount; } );
+		}
+		else{
+			const uint32_t* const indices = static_cast<const uint32_t*>( data );
+			return std::all_of( indices, indices + count, [this]( const uint32_t index ){ return index < header->vertexCount; } );
+		}
+	}
+
+	// drops the chunk's pages from memory once it is consumed
+	void releaseChunk( const uint32_t chunk ) const{ file.release( static_cast<size_t>( chunks[chunk].offset ), static_cast<size_t>( chunks[chunk].size ) ); }
+};
+
+// indexData may be NULL if indexCount is 0
+// returns false on failure; a previous file is left untouched then
+inline bool writeMeshFile(
+	const std::string& filename,
+	const VertexLayout vertexLayout, const uint32_t vertexStride,
+	const void* const vertexData, const uint64_t vertexCount,
+	const uint32_t indexSize, const void* const indexData, const uint64_t indexCount,
+	const uint64_t chunkSize = defaultMeshChunkSize
+){
+	const auto alignUp = []( const uint64_t x ){ return (x + meshFileAlignment - 1) / meshFileAlignment * meshFileAlignment; };
+
+	std::vector<MeshFileChunk> chunks;
+	std::vector<const unsigned char*> chunkSources;
+	const auto addChunks = [&]( const MeshChunkType type, const void* const data, const uint64_t count, const uint64_t elementSize ){
+		const uint64_t elementsPerChunk = std::max<uint64_t>( chunkSize / elementSize, 1 );
+		for( uint64_t first = 0; first < count; first += elementsPerChunk ){
+			const uint64_t size = std::min( elementsPerChunk, count - first ) * elementSize;
+			chunks.push_back(  { static_cast<uint32_t>( type ), 0, 0 /*offset assigned below*/, size, first }  );
+			chunkSources.push_back( static_cast<const unsigned char*>( data ) + first * elementSize );
+		}
+	};
+	addChunks( MeshChunkType::Vertices, vertexData, vertexCount, vertexStride );
+	if( indexCount ) addChunks( MeshChunkType::Indices, indexData, indexCount, indexSize );
+
+	MeshFileHeader header{
+		{}, // magic
+		meshFileVersion,
+		sizeof( MeshFileHeader ),
+		static_cast<uint32_t>( vertexLayout ),
+		vertexStride,
+		indexCount ? indexSize : 0,
+		static_cast<uint32_t>( chunks.size() ),
+		vertexCount,
+		indexCount,
+		sizeof( MeshFileHeader ), // chunk table right after the header
+		0 // reserved
+	};
+	std::memcpy( header.magic, meshFileMagic, sizeof( meshFileMagic ) );
+
+	uint64_t offset = alignUp( sizeof( MeshFileHeader ) + chunks.size() * sizeof( MeshFileChunk ) );
+	for( auto& chunk : chunks ){
+		chunk.offset = offset;
+		offset = alignUp( offset + chunk.size );
+	}
+
+	return writeFileAtomically( filename, [&]( std::FILE* file ){
+		if( std::fwrite( &header, sizeof( header ), 1, file ) != 1 ) return false;
+		if( !chunks.empty() && std::fwrite( chunks.data(), sizeof( MeshFileChunk ), chunks.size(), file ) != chunks.size() ) return false;
+
+		uint64_t position = sizeof( MeshFileHeader ) + chunks.size() * sizeof( MeshFileChunk );
+		const char padding[meshFileAlignment] = {};
+		for( size_t i = 0; i < chunks.size(); ++i ){
+			const size_t paddingSize = static_cast<size_t>( chunks[i].offset - position );
+			if( std::fwrite( padding, 1, paddingSize, file ) != paddingSize ) return false;
+			if( std::fwrite( chunkSources[i], 1, static_cast<size_t>( chunks[i].size ), file ) != chunks[i].size ) return false;
+			position = chunks[i].offset + chunks[i].size;
+		}
+		return true;
+	} );
+}
+
+#endif //COMMON_MESH_FILE_H
@@ -0,0 +1,164 @@
+// Low-overhead scoped CPU zones exported as Chrome trace-event JSON
+//
+// Recording is enabled at runtime by the HELLO_TRIANGLE_TRACE=file environment
+// variable; the file is written on exit and can be opened in Perfetto
+// (https://ui.perfetto.dev) or chrome://tracing.
+// Each thread writes finished zones into its own ring buffer without locking;
+// when the ring is full the oldest zones are overwritten.
+// With NO_PROFILER defined the profiler and the zones compile to nothing, and
+// HELLO_TRIANGLE_TRACE is ignored.
+
+#ifndef COMMON_PROFILER_H
+#define COMMON_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ErrorHandling.h"
+
+
+#ifndef NO_PROFILER
+
+// zones kept per thread; about 24 B each
+constexpr size_t profilerRingSize = 64 * 1024;
+
+class Profiler{
+	public:
+	using Clock = std::chrono::steady_clock;
+
+	static bool enabled(){ return profilerInstance.recording; }
+
+	static void record( const char* name, const Clock::time_point begin, const Clock::time_point end ){
+		Ring& ring = profilerInstance.threadRing();
+		ring.zones[ring.written % ring.zones.size()] = { name, begin, end };
+		++ring.written;
+	}
+
+	private:
+	static Profiler profilerInstance;
+
+	struct Zone{
+		const char* name; // must be a string literal (or otherwise outlive the profiler)
+		Clock::time_point begin;
+		Clock::time_point end;
+	};
+
+	struct Ring{
+		uint32_t threadId;
+		std::vector<Zone> zones;
+		uint64_t written; // total zones ever written; the newest is at (written - 1) % size
+	};
+
+	bool recording = false;
+	std::string traceFilename;
+	Clock::time_point epoch;
+
+	// owned here, so the rings outlive their threads
+	std::mutex ringsMutex;
+	std::vector< std::unique_ptr<Ring> > rings;
+
+	Ring& threadRing(){
+		thread_local Ring* ring = nullptr;
+		if( !ring ){
+			std::lock_guard<std::mutex> lock( ringsMutex );
+			rings.emplace_back(  new Ring{ static_cast<uint32_t>( rings.size() + 1 ), std::vector<Zone>( profilerRingSize ), 0 }  );
+			ring = rings.back().get();
+		}
+		return *ring;
+	}
+
+	Profiler(){
+		const char* const env = std::getenv( "HELLO_TRIANGLE_TRACE" );
+		if( !env || !*env ) return;
+
+		traceFilename = env;
+		recording = true;
+		threadRing(); // allocate the main thread ring now, not inside the first zone
+		epoch = Clock::now();
+	}
+
+	// expects the other threads are done recording by now
+	~Profiler(){
+		if( !recording ) return;
+		recording = false;
+
+		try{ writeTrace(); }
+		catch( ... ){ logger << "WARNING: Failed to write trace to " << traceFilename << "." << std::endl; }
+	}
+
+	double toMicroseconds( const Clock::duration d ) const{ return std::chrono::duration<double, std::micro>( d ).count(); }
+
+	void writeTrace(){
+		std::ofstream trace( traceFilename );
+		trace.precision( 3 );
+		trace << std::fixed;
+
+		trace << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+		uint64_t zoneCount = 0;
+		uint64_t overwritten = 0;
+		for( const auto& ring : rings ){
+			const uint64_t size = ring->zones.size();
+			const uint64_t first = ring->written > size ? ring->written - size : 0;
+			overwritten += first;
+
+			for( uint64_t i = first; i < ring->written; ++i ){
+				const Zone& zone = ring->zones[i % size];
+				trace << (zoneCount++ ? ",\n" : "\n")
+				      << "{\"name\": \"" << zone.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << ring->threadId
+				      << ", \"ts\": " << toMicroseconds( zone.begin - epoch ) << ", \"dur\": " << toMicroseconds( zone.end - zone.begin ) << "}";
+			}
+		}
+
+		trace << "\n]}\n";
+		trace.close();
+		if( !trace ) throw "Trouble writing trace file!";
+
+		logger << "INFO: Trace of " << zoneCount << " zone(s) written to " << traceFilename << "." << std::endl;
+		if( overwritten ) logger << "WARNING: " << overwritten << " oldest zone(s) were overwritten; increase profilerRingSize." << std::endl;
+	}
+};
+Profiler Profiler::profilerInstance;
+
+// measures the enclosing scope
+class ProfileZone{
+	const char* name; // NULL when not recording
+	Profiler::Clock::time_point begin;
+
+	public:
+	explicit ProfileZone( const char* name ) : name( Profiler::enabled() ? name : nullptr ){
+		if( this->name ) begin = Profiler::Clock::now();
+	}
+
+	~ProfileZone(){
+		if( name ) Profiler::record( name, begin, Profiler::Clock::now() );
+	}
+
+	ProfileZone( const ProfileZone& ) = delete;
+	ProfileZone& operator=( const ProfileZone& ) = delete;
+};
+
+#define PROFILE_CONCAT_HELPER( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_HELPER( a, b )
+
+#define PROFILE_ZONE( name ) const ProfileZone PROFILE_CONCAT( profileZone, __LINE__ )( name )
+
+#else
+
+#define PROFILE_ZONE( name )
+
+#endif //NO_PROFILER
+
+// zone named after the enclosing function
+#define PROFILE_FUNCTION() PROFILE_ZONE( __func__ )
+
+// usage:
+//PROFILE_ZONE( "render" );
+
+#endif //COMMON_PROFILER_H
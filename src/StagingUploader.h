@@ -0,0 +1,245 @@
+// Uploads of host data into device memory that does not need to be host visible
+//
+// The data is written into a host visible staging buffer and copied by
+// vkCmdCopyBuffer, preferably on a dedicated transfer queue (the DMA engine of
+// discrete GPUs). Uploads are batched; a batch is submitted when its staging
+// buffer is full, or by flush(). The consumer queue waits on the batch with a
+// semaphore, and a fence on that wait tracks the completion, so the staging
+// buffer of a batch is reused only once the consumer is past it.
+
+#ifndef COMMON_STAGING_UPLOADER_H
+#define COMMON_STAGING_UPLOADER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "ErrorHandling.h"
+#include "HostUpload.h"
+#include "MemoryAllocator.h"
+
+
+class StagingUploader{
+	struct Batch{
+		VkBuffer stagingBuffer;
+		MemoryAllocation stagingMemory;
+		unsigned char* staging; // persistently mapped
+		VkDeviceSize used;
+		VkCommandBuffer commandBuffer;
+		VkSemaphore transferDoneS; // waited on by the consumer queue
+		VkFence fence; // signaled once the consumer queue waited on the batch
+		bool recording;
+	};
+
+	VkDevice device;
+	DeviceMemoryAllocator& allocator;
+	VkQueue transferQueue;
+	VkQueue consumerQueue;
+	VkPipelineStageFlags consumerStages;
+	VkDeviceSize capacity; // of each staging buffer
+	VkMemoryPropertyFlags stagingFlags = 0; // of the staging memory; picks the copy into it
+
+	VkCommandPool commandPool;
+	std::vector<Batch> batches;
+	uint32_t current = 0;
+
+	// copies to the same buffer are merged into one vkCmdCopyBuffer
+	VkBuffer pendingDestination = VK_NULL_HANDLE;
+	std::vector<VkBufferCopy> pendingRegions;
+
+	uint64_t uploadedBytes = 0;
+	uint64_t submittedBatches = 0;
+
+	static constexpr VkDeviceSize copyAlignment = 16; // keeps the copy sources nicely aligned for the DMA
+
+	Batch& beginBatch(){
+		Batch& batch = batches[current];
+		if( batch.recording ) return batch;
+
+		// the consumer might still be using the previous upload of this batch
+		VkResult errorCode = vkWaitForFences( device, 1, &batch.fence, VK_TRUE, UINT64_MAX ); RESULT_HANDLER( errorCode, "vkWaitForFences" );
+		errorCode = vkResetFences( device, 1, &batch.fence ); RESULT_HANDLER( errorCode, "vkResetFences" );
+		errorCode = vkResetCommandBuffer( batch.commandBuffer, 0 ); RESULT_HANDLER( errorCode, "vkResetCommandBuffer" );
+
+		const VkCommandBufferBeginInfo beginInfo{
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			nullptr, // pNext
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			nullptr // inheritance
+		};
+		errorCode = vkBeginCommandBuffer( batch.commandBuffer, &beginInfo ); RESULT_HANDLER( errorCode, "vkBeginCommandBuffer" );
+
+		batch.used = 0;
+		batch.recording = true;
+		return batch;
+	}
+
+	void recordPendingCopies(){
+		if( pendingRegions.empty() ) return;
+
+		vkCmdCopyBuffer( batches[current].commandBuffer, batches[current].stagingBuffer, pendingDestination, static_cast<uint32_t>( pendingRegions.size() ), pendingRegions.data() );
+		pendingRegions.clear();
+		pendingDestination = VK_NULL_HANDLE;
+	}
+
+	public:
+	// transferQueue can be the same as consumerQueue
+	// destination buffers must be usable from both queue families (CONCURRENT sharing if they differ)
+	StagingUploader(
+		const VkDevice device,
+		DeviceMemoryAllocator& allocator,
+		const uint32_t transferQueueFamily, const VkQueue transferQueue,
+		const VkQueue consumerQueue, const VkPipelineStageFlags consumerStages,
+		const VkDeviceSize capacity,
+		const uint32_t batchCount = 2
+	)
+	: device( device ), allocator( allocator ), transferQueue( transferQueue ), consumerQueue( consumerQueue ), consumerStages( consumerStages ), capacity( capacity ){
+		const VkCommandPoolCreateInfo commandPoolInfo{
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			nullptr, // pNext
+			VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+			transferQueueFamily
+		};
+		VkResult errorCode = vkCreateCommandPool( device, &commandPoolInfo, nullptr, &commandPool ); RESULT_HANDLER( errorCode, "vkCreateCommandPool" );
+
+		for( uint32_t i = 0; i < batchCount; ++i ){
+			Batch batch{};
+
+			const VkBufferCreateInfo bufferInfo{
+				VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+				nullptr, // pNext
+				0, // flags
+				capacity,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_SHARING_MODE_EXCLUSIVE, // only ever used by the transfer queue
+				0, nullptr // queue families -- ignored for EXCLUSIVE
+			};
+			errorCode = vkCreateBuffer( device, &bufferInfo, nullptr, &batch.stagingBuffer ); RESULT_HANDLER( errorCode, "vkCreateBuffer" );
+
+			// HOST_VISIBLE | HOST_COHERENT is guaranteed to exist for buffers
+			VkMemoryRequirements requirements;
+			vkGetBufferMemoryRequirements( device, batch.stagingBuffer, &requirements );
+			const VkPhysicalDeviceMemoryProperties& memoryProperties = allocator.getMemoryProperties();
+			const VkMemoryPropertyFlags requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			uint32_t memoryType = 0;
+			while( !(requirements.memoryTypeBits & (1u << memoryType)) || (memoryProperties.memoryTypes[memoryType].propertyFlags & requiredFlags) != requiredFlags ){
+				if( ++memoryType == memoryProperties.memoryTypeCount ) throw "Can't find host visible coherent memory for the staging buffer!";
+			}
+
+			batch.stagingMemory = allocator.allocate( requirements, memoryType, true /*linear*/ );
+			errorCode = vkBindBufferMemory( device, batch.stagingBuffer, batch.stagingMemory.memory, batch.stagingMemory.offset ); RESULT_HANDLER( errorCode, "vkBindBufferMemory" );
+			batch.staging = static_cast<unsigned char*>(  allocator.map( batch.stagingMemory )  );
+			stagingFlags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+
+			const VkCommandBufferAllocateInfo commandBufferInfo{
+				VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				nullptr, // pNext
+				commandPool,
+				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				1 // count
+			};
+			errorCode = vkAllocateCommandBuffers( device, &commandBufferInfo, &batch.commandBuffer ); RESULT_HANDLER( errorCode, "vkAllocateCommandBuffers" );
+
+			const VkSemaphoreCreateInfo semaphoreInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, nullptr, 0 };
+			errorCode = vkCreateSemaphore( device, &semaphoreInfo, nullptr, &batch.transferDoneS ); RESULT_HANDLER( errorCode, "vkCreateSemaphore" );
+
+			const VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, VK_FENCE_CREATE_SIGNALED_BIT };
+			errorCode = vkCreateFence( device, &fenceInfo, nullptr, &batch.fence ); RESULT_HANDLER( errorCode, "vkCreateFence" );
+
+			batches.push_back( batch );
+		}
+	}
+
+	StagingUploader( const StagingUploader& ) = delete;
+	StagingUploader& operator=( const StagingUploader& ) = delete;
+
+	// the data is copied right away; the destination is written once the batch is flushed
+	void upload( const VkBuffer destination, VkDeviceSize destinationOffset, const void* data, VkDeviceSize size ){
+		const unsigned char* bytes = static_cast<const unsigned char*>( data );
+
+		while( size ){
+			Batch& batch = beginBatch();
+
+			const VkDeviceSize offset = (batch.used + copyAlignment - 1) / copyAlignment * copyAlignment;
+			if( offset >= capacity ){
+				flush();
+				continue;
+			}
+
+			const VkDeviceSize chunk = std::min( size, capacity - offset );
+			copyToHostMemory( batch.staging + offset, bytes, static_cast<size_t>( chunk ), stagingFlags );
+
+			if( destination != pendingDestination ) recordPendingCopies();
+			pendingDestination = destination;
+			pendingRegions.push_back( {offset, destinationOffset, chunk} );
+
+			batch.used = offset + chunk;
+			bytes += chunk;
+			destinationOffset += chunk;
+			size -= chunk;
+			uploadedBytes += chunk;
+		}
+	}
+
+	// submits the current batch; the work submitted to the consumer queue afterwards sees the uploaded data
+	void flush(){
+		Batch& batch = batches[current];
+		if( !batch.recording ) return;
+
+		recordPendingCopies();
+		VkResult errorCode = vkEndCommandBuffer( batch.commandBuffer ); RESULT_HANDLER( errorCode, "vkEndCommandBuffer" );
+
+		const VkSubmitInfo transferSubmit{
+			VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			nullptr, // pNext
+			0, nullptr, nullptr, // wait semaphores
+			1, &batch.commandBuffer,
+			1, &batch.transferDoneS // signal semaphores
+		};
+		errorCode = vkQueueSubmit( transferQueue, 1, &transferSubmit, VK_NULL_HANDLE ); RESULT_HANDLER( errorCode, "vkQueueSubmit" );
+
+		// empty batch; its semaphore wait also covers everything submitted later to the consumer queue
+		const VkSubmitInfo consumerSubmit{
+			VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			nullptr, // pNext
+			1, &batch.transferDoneS, &consumerStages, // wait semaphores
+			0, nullptr, // command buffers
+			0, nullptr // signal semaphores
+		};
+		errorCode = vkQueueSubmit( consumerQueue, 1, &consumerSubmit, batch.fence ); RESULT_HANDLER( errorCode, "vkQueueSubmit" );
+
+		batch.recording = false;
+		current = (current + 1) % static_cast<uint32_t>( batches.size() );
+		++submittedBatches;
+	}
+
+	// waits until all submitted uploads are finished
+	void wait(){
+		for( const auto& batch : batches ){
+			VkResult errorCode = vkWaitForFences( device, 1, &batch.fence, VK_TRUE, UINT64_MAX ); RESULT_HANDLER( errorCode, "vkWaitForFences" );
+		}
+	}
+
+	uint64_t getUploadedBytes() const{ return uploadedBytes; }
+	uint64_t getSubmittedBatches() const{ return submittedBatches; }
+
+	// must be called before the allocator and the device are killed
+	void kill(){
+		flush();
+		wait();
+
+		for( auto& batch : batches ){
+			vkDestroyFence( device, batch.fence, nullptr );
+			vkDestroySemaphore( device, batch.transferDoneS, nullptr );
+			vkDestroyBuffer( device, batch.stagingBuffer, nullptr );
+			allocator.free( batch.stagingMemory );
+		}
+		batches.clear();
+
+		vkDestroyCommandPool( device, commandPool, nullptr ); // frees the command buffers too
+	}
+};
+
+#endif //COMMON_STAGING_UPLOADER_H
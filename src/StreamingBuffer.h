@@ -0,0 +1,75 @@
+// Ring of per-frame regions of a persistently mapped buffer
+//
+// For data that changes every frame (vertices, indices, uniforms). The buffer
+// is split into one region per frame in flight; a frame bump-allocates its
+// slices from its region, and the region is reset when the frame context is
+// reused -- i.e. only after the GPU is finished with the frame that wrote it.
+// Nothing is mapped or unmapped per frame.
+
+#ifndef COMMON_STREAMING_BUFFER_H
+#define COMMON_STREAMING_BUFFER_H
+
+#include <cassert>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+
+struct StreamingSlice{
+	VkBuffer buffer;
+	VkDeviceSize offset; // into the buffer; for binding
+	void* data; // host pointer to write the data through
+};
+
+class StreamingBuffer{
+	VkBuffer buffer;
+	unsigned char* mapped; // whole buffer
+	VkDeviceSize regionSize;
+	uint32_t regionCount;
+	VkDeviceSize minUniformAlignment;
+
+	uint32_t region = 0;
+	VkDeviceSize top = 0; // inside the current region
+	VkDeviceSize peak = 0; // the most any region used so far
+
+	public:
+	// mapped points to the start of the buffer of size regionSize * regionCount; it must be HOST_COHERENT
+	StreamingBuffer( const VkBuffer buffer, void* const mapped, const VkDeviceSize regionSize, const uint32_t regionCount, const VkPhysicalDeviceLimits& limits )
+	: buffer( buffer ), mapped( static_cast<unsigned char*>( mapped ) ), regionSize( regionSize ), regionCount( regionCount ), minUniformAlignment( limits.minUniformBufferOffsetAlignment ){}
+
+	// called once the GPU is done with the frame that last used the region
+	void beginRegion( const uint32_t newRegion ){
+		assert( newRegion < regionCount );
+		region = newRegion;
+		top = 0;
+	}
+
+	// alignment must be a power of two
+	StreamingSlice allocate( const VkDeviceSize size, const VkDeviceSize alignment ){
+		const VkDeviceSize begin = (top + alignment - 1) & ~(alignment - 1);
+		if( begin + size > regionSize ) throw "Per-frame streaming memory exhausted! Increase streamingRegionSize.";
+
+		top = begin + size;
+		if( top > peak ) peak = top;
+
+		const VkDeviceSize offset = region * regionSize + begin;
+		return { buffer, offset, mapped + offset };
+	}
+
+	template< typename Vertex >
+	StreamingSlice allocateVertices( const size_t count ){ return allocate( sizeof( Vertex ) * count, alignof( Vertex ) ); }
+
+	template< typename Index >
+	StreamingSlice allocateIndices( const size_t count ){
+		static_assert( sizeof( Index ) == 2 || sizeof( Index ) == 4, "Vulkan indices are 16 or 32 bit." );
+		return allocate( sizeof( Index ) * count, sizeof( Index ) );
+	}
+
+	StreamingSlice allocateUniform( const VkDeviceSize size ){ return allocate( size, minUniformAlignment ); }
+
+	VkDeviceSize used() const{ return top; }
+	VkDeviceSize peakUsed() const{ return peak; }
+	VkDeviceSize capacity() const{ return regionSize; }
+};
+
+#endif //COMMON_STREAMING_BUFFER_H
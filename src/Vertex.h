@@ -3,6 +3,12 @@
 #ifndef COMMON_VERTEX_H
 #define COMMON_VERTEX_H
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
 struct Vertex2D{
 	float position[2];
 };
@@ -16,4 +22,95 @@ struct Vertex2D_ColorF_pack{
 	ColorF color;
 };
 
+// quantized variant; 8 B per vertex instead of 20 B
+struct Vertex2D_S16{
+	int16_t position[2]; // SNORM16: [-32767, 32767] is [-1.0, 1.0]
+};
+
+struct ColorU8{
+	uint8_t color[4]; // UNORM8; the fourth is just padding to keep the vertex 4 B aligned
+};
+
+struct Vertex2D_S16_ColorU8_pack{
+	Vertex2D_S16 position;
+	ColorU8 color;
+};
+static_assert( sizeof( Vertex2D_S16_ColorU8_pack ) == 8, "Quantized vertex must have no padding." );
+
+// per-instance data of the instanced draw; 16 B
+struct Instance2D_ColorU8{
+	float offset[2]; // added to the scaled vertex position
+	float scale;
+	ColorU8 color; // multiplies the vertex color
+};
+static_assert( sizeof( Instance2D_ColorU8 ) == 16, "Instance must have no padding." );
+
+// identifies the vertex struct in files and picks the pipeline's vertex input formats
+enum class VertexLayout : uint32_t{
+	Position2D_ColorF = 1, // Vertex2D_ColorF_pack
+	Position2D_S16_ColorU8 = 2 // Vertex2D_S16_ColorU8_pack
+};
+
+// returns 0 for an unknown layout
+constexpr uint32_t getVertexStride( const VertexLayout layout ){
+	switch( layout ){
+		case VertexLayout::Position2D_ColorF: return sizeof( Vertex2D_ColorF_pack );
+		case VertexLayout::Position2D_S16_ColorU8: return sizeof( Vertex2D_S16_ColorU8_pack );
+		default: return 0;
+	}
+}
+
+
+// Quantization
+// Values in range come back off by at most half a step (plus the float rounding);
+// values out of range are clamped, which can be off by any amount.
+
+constexpr float snorm16MaxError = 0.5f / 32767.0f + std::numeric_limits<float>::epsilon();
+constexpr float unorm8MaxError = 0.5f / 255.0f + std::numeric_limits<float>::epsilon();
+
+inline int16_t quantizeSnorm16( const float x ){ return static_cast<int16_t>(  std::lround( std::min( std::max( x, -1.0f ), 1.0f ) * 32767.0f )  ); }
+inline float dequantizeSnorm16( const int16_t q ){ return std::max( static_cast<float>( q ) / 32767.0f, -1.0f ); } // as the GPU does: -32768 is -1.0 too
+
+inline uint8_t quantizeUnorm8( const float x ){ return static_cast<uint8_t>(  std::lround( std::min( std::max( x, 0.0f ), 1.0f ) * 255.0f )  ); }
+inline float dequantizeUnorm8( const uint8_t q ){ return static_cast<float>( q ) / 255.0f; }
+
+struct QuantizationError{
+	float maxPositionError; // absolute, per component
+	float maxColorError; // absolute, per component
+	uint64_t clampedValues; // out of range on input
+};
+
+inline Vertex2D_S16_ColorU8_pack quantizeVertex( const Vertex2D_ColorF_pack& v ){
+	return {
+		{ {quantizeSnorm16( v.position.position[0] ), quantizeSnorm16( v.position.position[1] )} },
+		{ {quantizeUnorm8( v.color.color[0] ), quantizeUnorm8( v.color.color[1] ), quantizeUnorm8( v.color.color[2] ), 255} }
+	};
+}
+
+// the measured error can be checked against snorm16MaxError and unorm8MaxError; it stays within them if nothing was clamped
+inline std::vector<Vertex2D_S16_ColorU8_pack> quantizeVertices( const std::vector<Vertex2D_ColorF_pack>& vertices, QuantizationError* const error = nullptr ){
+	std::vector<Vertex2D_S16_ColorU8_pack> quantized;
+	quantized.reserve( vertices.size() );
+
+	QuantizationError e{ 0.0f, 0.0f, 0 };
+	for( const auto& v : vertices ){
+		quantized.push_back( quantizeVertex( v ) );
+		const Vertex2D_S16_ColorU8_pack& q = quantized.back();
+
+		for( int i = 0; i < 2; ++i ){
+			const float x = v.position.position[i];
+			if( x < -1.0f || x > 1.0f ) ++e.clampedValues;
+			e.maxPositionError = std::max(  e.maxPositionError, std::fabs( x - dequantizeSnorm16( q.position.position[i] ) )  );
+		}
+		for( int i = 0; i < 3; ++i ){
+			const float x = v.color.color[i];
+			if( x < 0.0f || x > 1.0f ) ++e.clampedValues;
+			e.maxColorError = std::max(  e.maxColorError, std::fabs( x - dequantizeUnorm8( q.color.color[i] ) )  );
+		}
+	}
+
+	if( error ) *error = e;
+	return quantized;
+}
+
 #endif //COMMON_VERTEX_H
@@ -0,0 +1,170 @@
+// Triangle and vertex order of indexed meshes, for the GPU vertex caches
+//
+// The vertex shader results are kept in a small post-transform cache, so a
+// vertex shared by consecutive triangles is transformed once. The triangles are
+// reordered with Tipsify (Sander, Nehab and Barczak: Fast Triangle Reordering
+// for Vertex Locality and Reduced Overdraw, 2007): it fans around a vertex until
+// its triangles are used up, then moves on to the neighbour still in the cache
+// that has the most triangles left. It is linear in the index count and needs
+// only the cache size.
+// Then the vertices are renumbered in the order the triangles first use them,
+// so the vertex fetch reads the vertex buffer mostly sequentially.
+// The cache is measured by simulating a FIFO cache of the same size:
+// ACMR (average cache miss ratio) is the transformed vertices per triangle
+// (0.5 at best for big regular meshes, 3 at worst), ATVR (average transformed
+// vertex ratio) the transformed vertices per referenced vertex (1 at best).
+// Indices are 16- or 32-bit; the functions are templated on the index type.
+// They allocate several per-vertex and per-index arrays; estimateMeshOptimizationMemory
+// bounds the peak for a caller that holds the whole mesh in memory.
+
+#ifndef COMMON_VERTEX_CACHE_OPTIMIZER_H
+#define COMMON_VERTEX_CACHE_OPTIMIZER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+struct VertexCacheStats{
+	double acmr; // transformed vertices per triangle
+	double atvr; // transformed vertices per referenced vertex
+};
+
+// peak bytes of a copy of the mesh plus the arrays of analyzeVertexCache, optimizeVertexCache and optimizeVertexFetch run on it
+// in 64 bits, as it may not fit size_t
+inline uint64_t estimateMeshOptimizationMemory( const uint64_t vertexCount, const uint64_t vertexStride, const uint64_t indexCount, const uint64_t indexSize ){
+	const uint64_t mesh = vertexCount * vertexStride + indexCount * indexSize;
+	const uint64_t analyze = vertexCount * sizeof( uint64_t ); // insertedAt
+	const uint64_t tipsify =
+		vertexCount * sizeof( uint32_t ) // liveTriangles
+		+ (2 * vertexCount + 1) * sizeof( size_t ) // adjacencyOffsets, and their fill cursors
+		+ indexCount * sizeof( uint32_t ) // adjacency
+		+ vertexCount * sizeof( uint64_t ) // cacheTime
+		+ indexCount / 3 / 8 + 1 // emitted
+		+ 3 * indexCount * indexSize; // deadEnds, candidates and output, each at most an element per index
+	const uint64_t fetch = vertexCount * sizeof( size_t ) + vertexCount * vertexStride; // remap, original
+	return mesh + std::max( std::max( analyze, tipsify ), fetch );
+}
+
+// all indices must be below vertexCount; indexCount a multiple of 3 (triangle list)
+template< typename Index >
+VertexCacheStats analyzeVertexCache( const Index* const indices, const size_t indexCount, const size_t vertexCount, const uint32_t cacheSize ){
+	const uint64_t never = ~uint64_t( 0 );
+	std::vector<uint64_t> insertedAt( vertexCount, never ); // miss count after the vertex entered the cache
+
+	uint64_t misses = 0;
+	size_t referencedVertices = 0;
+	for( size_t i = 0; i < indexCount; ++i ){
+		const Index v = indices[i];
+		if( insertedAt[v] == never ) ++referencedVertices;
+		else if( misses - insertedAt[v] < cacheSize ) continue; // FIFO: still in the cache if fewer than cacheSize vertices entered after it
+
+		insertedAt[v] = ++misses;
+	}
+
+	const size_t triangleCount = indexCount / 3;
+	return {
+		triangleCount ? static_cast<double>( misses ) / static_cast<double>( triangleCount ) : 0.0,
+		referencedVertices ? static_cast<double>( misses ) / static_cast<double>( referencedVertices ) : 0.0
+	};
+}
+
+// Tipsify; reorders the triangles of the list in place
+// all indices must be below vertexCount; indexCount a multiple of 3
+template< typename Index >
+void optimizeVertexCache( Index* const indices, const size_t indexCount, const size_t vertexCount, const uint32_t cacheSize ){
+	const size_t triangleCount = indexCount / 3;
+	if( !triangleCount ) return;
+
+	// triangles of each vertex
+	std::vector<uint32_t> liveTriangles( vertexCount, 0 ); // not emitted yet
+	for( size_t i = 0; i < indexCount; ++i ) ++liveTriangles[indices[i]];
+
+	std::vector<size_t> adjacencyOffsets( vertexCount + 1, 0 );
+	for( size_t v = 0; v < vertexCount; ++v ) adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	std::vector<uint32_t> adjacency( indexCount );
+	{
+		std::vector<size_t> fill( adjacencyOffsets.begin(), adjacencyOffsets.end() - 1 );
+		for( size_t i = 0; i < indexCount; ++i ) adjacency[fill[indices[i]]++] = static_cast<uint32_t>( i / 3 );
+	}
+
+	std::vector<uint64_t> cacheTime( vertexCount, 0 ); // time the vertex entered the (simulated) cache
+	std::vector<bool> emitted( triangleCount, false );
+	std::vector<Index> deadEnds; // recently used vertices, to continue from when the fan runs dry
+	std::vector<Index> candidates;
+	std::vector<Index> output;
+	output.reserve( indexCount );
+
+	uint64_t time = cacheSize + 1; // so no vertex starts in the cache
+	size_t cursor = 0; // vertices before it have no live triangles
+
+	// a vertex with live triangles, preferably a recent one; vertexCount if none is left
+	const auto skipDeadEnd = [&](){
+		while( !deadEnds.empty() ){
+			const Index d = deadEnds.back();
+			deadEnds.pop_back();
+			if( liveTriangles[d] ) return static_cast<size_t>( d );
+		}
+		while( cursor < vertexCount && !liveTriangles[cursor] ) ++cursor;
+		return cursor;
+	};
+
+	size_t fan = skipDeadEnd();
+	while( fan < vertexCount ){
+		candidates.clear();
+		for( size_t a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; ++a ){
+			const uint32_t t = adjacency[a];
+			if( emitted[t] ) continue;
+			emitted[t] = true;
+
+			for( int c = 0; c < 3; ++c ){
+				const Index v = indices[3 * t + c];
+				output.push_back( v );
+				deadEnds.push_back( v );
+				candidates.push_back( v );
+				--liveTriangles[v];
+				if( time - cacheTime[v] > cacheSize ) cacheTime[v] = time++;
+			}
+		}
+
+		// the candidate that is in the cache, and still will be after its remaining triangles, that entered it the earliest
+		size_t next = vertexCount;
+		int64_t bestPriority = -1;
+		for( const Index v : candidates ){
+			if( !liveTriangles[v] ) continue;
+
+			int64_t priority = 0;
+			if( time - cacheTime[v] + 2 * uint64_t( liveTriangles[v] ) <= cacheSize ) priority = static_cast<int64_t>( time - cacheTime[v] );
+			if( priority > bestPriority ){
+				bestPriority = priority;
+				next = v;
+			}
+		}
+		fan = next < vertexCount ? next : skipDeadEnd();
+	}
+
+	std::memcpy( indices, output.data(), indexCount * sizeof( Index ) );
+}
+
+// renumbers the vertices in the order of their first use by the indices, and moves them accordingly
+// unreferenced vertices go to the end, in their original order
+// vertices is vertexCount elements of vertexStride bytes; all indices must be below vertexCount
+template< typename Index >
+void optimizeVertexFetch( void* const vertices, const size_t vertexCount, const size_t vertexStride, Index* const indices, const size_t indexCount ){
+	const size_t unassigned = ~size_t( 0 );
+	std::vector<size_t> remap( vertexCount, unassigned );
+
+	size_t next = 0;
+	for( size_t i = 0; i < indexCount; ++i ){
+		if( remap[indices[i]] == unassigned ) remap[indices[i]] = next++;
+		indices[i] = static_cast<Index>( remap[indices[i]] );
+	}
+	for( size_t v = 0; v < vertexCount; ++v ) if( remap[v] == unassigned ) remap[v] = next++;
+
+	unsigned char* const bytes = static_cast<unsigned char*>( vertices );
+	const std::vector<unsigned char> original( bytes, bytes + vertexCount * vertexStride );
+	for( size_t v = 0; v < vertexCount; ++v ) std::memcpy( bytes + remap[v] * vertexStride, original.data() + v * vertexStride, vertexStride );
+}
+
+#endif //COMMON_VERTEX_CACHE_OPTIMIZER_H
@@ -0,0 +1,202 @@
+// Pipeline vertex input state generated from the vertex structs
+//
+// Each vertex struct of Vertex.h gets a VertexTraits specialization listing
+// its VertexLayout, input rate and its attributes (shader location, VkFormat,
+// and the member it reads). Per-instance structs are described the same way,
+// without a layout (they are not in mesh files). The
+// binding and attribute descriptions are generated from it, so adding a layout
+// is one specialization and the descriptions cannot drift out of sync with the
+// struct. Everything is checked at compile time: each format must cover exactly
+// the bytes of its member, keep the alignment of its components, and fit in the
+// minimum vertex input limits the spec guarantees on every device.
+
+#ifndef COMMON_VERTEX_INPUT_H
+#define COMMON_VERTEX_INPUT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Vertex.h"
+
+
+// minimum values of the VkPhysicalDeviceLimits every implementation has to support
+constexpr uint32_t minMaxVertexInputAttributes = 16;
+constexpr uint32_t minMaxVertexInputAttributeOffset = 2047;
+constexpr uint32_t minMaxVertexInputBindingStride = 2048;
+
+// locations of the vertex shader inputs
+constexpr uint32_t positionLocation = 0;
+constexpr uint32_t colorLocation = 1;
+constexpr uint32_t instanceOffsetLocation = 2; // only in the instanced vertex shader
+constexpr uint32_t instanceScaleLocation = 3;
+constexpr uint32_t instanceColorLocation = 4;
+
+struct VertexAttribute{
+	uint32_t location;
+	VkFormat format;
+	uint32_t offset; // in the vertex struct
+	uint32_t size; // of the member the format reads
+};
+
+// the member is named once, so the offset and the size can't disagree
+#define VERTEX_ATTRIBUTE( vertex, member, location, format ) VertexAttribute{ location, format, static_cast<uint32_t>( offsetof( vertex, member ) ), static_cast<uint32_t>( sizeof( vertex::member ) ) }
+
+template< typename Vertex > struct VertexTraits; // specialized for each vertex struct
+
+template<> struct VertexTraits<Vertex2D_ColorF_pack>{
+	static constexpr VertexLayout layout = VertexLayout::Position2D_ColorF;
+	static constexpr VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	static constexpr std::array<VertexAttribute, 2> attributes(){
+		return {{
+			VERTEX_ATTRIBUTE( Vertex2D_ColorF_pack, position, positionLocation, VK_FORMAT_R32G32_SFLOAT ),
+			VERTEX_ATTRIBUTE( Vertex2D_ColorF_pack, color, colorLocation, VK_FORMAT_R32G32B32_SFLOAT )
+		}};
+	}
+};
+
+// both formats are mandatory for vertex buffers; the shader reads the same floats
+template<> struct VertexTraits<Vertex2D_S16_ColorU8_pack>{
+	static constexpr VertexLayout layout = VertexLayout::Position2D_S16_ColorU8;
+	static constexpr VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	static constexpr std::array<VertexAttribute, 2> attributes(){
+		return {{
+			VERTEX_ATTRIBUTE( Vertex2D_S16_ColorU8_pack, position, positionLocation, VK_FORMAT_R16G16_SNORM ),
+			VERTEX_ATTRIBUTE( Vertex2D_S16_ColorU8_pack, color, colorLocation, VK_FORMAT_R8G8B8A8_UNORM )
+		}};
+	}
+};
+
+template<> struct VertexTraits<Instance2D_ColorU8>{
+	static constexpr VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+	static constexpr std::array<VertexAttribute, 3> attributes(){
+		return {{
+			VERTEX_ATTRIBUTE( Instance2D_ColorU8, offset, instanceOffsetLocation, VK_FORMAT_R32G32_SFLOAT ),
+			VERTEX_ATTRIBUTE( Instance2D_ColorU8, scale, instanceScaleLocation, VK_FORMAT_R32_SFLOAT ),
+			VERTEX_ATTRIBUTE( Instance2D_ColorU8, color, instanceColorLocation, VK_FORMAT_R8G8B8A8_UNORM )
+		}};
+	}
+};
+
+
+// Compile-time checks
+// (indexed loops, as std::array's iterators are not constexpr before C++17)
+
+// returns 0 for formats not used by any vertex struct yet
+constexpr uint32_t getFormatComponentSize( const VkFormat format ){
+	switch( format ){
+		case VK_FORMAT_R8G8B8A8_UNORM: return 1;
+		case VK_FORMAT_R16G16_SNORM: return 2;
+		case VK_FORMAT_R32_SFLOAT:
+		case VK_FORMAT_R32G32_SFLOAT:
+		case VK_FORMAT_R32G32B32_SFLOAT: return 4;
+		default: return 0;
+	}
+}
+
+constexpr uint32_t getFormatSize( const VkFormat format ){
+	switch( format ){
+		case VK_FORMAT_R8G8B8A8_UNORM: return 4;
+		case VK_FORMAT_R16G16_SNORM: return 4;
+		case VK_FORMAT_R32_SFLOAT: return 4;
+		case VK_FORMAT_R32G32_SFLOAT: return 8;
+		case VK_FORMAT_R32G32B32_SFLOAT: return 12;
+		default: return 0;
+	}
+}
+
+template< typename Vertex >
+constexpr bool formatsMatchMembers(){
+	const auto attributes = VertexTraits<Vertex>::attributes();
+	for( size_t i = 0; i < attributes.size(); ++i ){
+		if( !getFormatSize( attributes[i].format ) || getFormatSize( attributes[i].format ) != attributes[i].size ) return false;
+	}
+	return true;
+}
+
+template< typename Vertex >
+constexpr bool attributesAligned(){
+	const auto attributes = VertexTraits<Vertex>::attributes();
+	for( size_t i = 0; i < attributes.size(); ++i ){
+		const uint32_t componentSize = getFormatComponentSize( attributes[i].format );
+		if( !componentSize || attributes[i].offset % componentSize || sizeof( Vertex ) % componentSize ) return false;
+	}
+	return true;
+}
+
+template< typename Vertex >
+constexpr bool locationsValid(){
+	const auto attributes = VertexTraits<Vertex>::attributes();
+	for( size_t i = 0; i < attributes.size(); ++i ){
+		if( attributes[i].location >= minMaxVertexInputAttributes ) return false;
+		for( size_t j = 0; j < i; ++j ) if( attributes[j].location == attributes[i].location ) return false;
+	}
+	return true;
+}
+
+template< typename Vertex >
+constexpr uint32_t maxAttributeOffset(){
+	const auto attributes = VertexTraits<Vertex>::attributes();
+	uint32_t maxOffset = 0;
+	for( size_t i = 0; i < attributes.size(); ++i ) if( attributes[i].offset > maxOffset ) maxOffset = attributes[i].offset;
+	return maxOffset;
+}
+
+
+// Descriptions for a vertex struct; instantiating it runs the checks
+template< typename Vertex >
+struct VertexInput{
+	using Traits = VertexTraits<Vertex>;
+	static constexpr uint32_t stride = sizeof( Vertex );
+	static constexpr uint32_t attributeCount = static_cast<uint32_t>( Traits::attributes().size() );
+
+	static_assert( formatsMatchMembers<Vertex>(), "Attribute format does not cover exactly its vertex struct member." );
+	static_assert( attributesAligned<Vertex>(), "Attribute offset or vertex stride is not aligned to the format's components." );
+	static_assert( locationsValid<Vertex>(), "Attribute locations must be unique and below the minimum maxVertexInputAttributes." );
+	static_assert( attributeCount <= minMaxVertexInputAttributes, "More attributes than the minimum maxVertexInputAttributes." );
+	static_assert( maxAttributeOffset<Vertex>() <= minMaxVertexInputAttributeOffset, "Attribute offset over the minimum maxVertexInputAttributeOffset." );
+	static_assert( stride <= minMaxVertexInputBindingStride, "Vertex stride over the minimum maxVertexInputBindingStride." );
+
+	static VkVertexInputBindingDescription getBindingDescription( const uint32_t binding ){
+		return { binding, stride, Traits::inputRate };
+	}
+
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions( const uint32_t binding ){
+		std::vector<VkVertexInputAttributeDescription> descriptions;
+		for( const VertexAttribute& a : Traits::attributes() ) descriptions.push_back(  { a.location, binding, a.format, a.offset }  );
+		return descriptions;
+	}
+};
+
+struct VertexInputDescriptions{
+	VkVertexInputBindingDescription binding;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+	uint32_t maxAttributeOffset;
+};
+
+template< typename Vertex >
+VertexInputDescriptions getVertexInputDescriptions( const uint32_t binding ){
+	return { VertexInput<Vertex>::getBindingDescription( binding ), VertexInput<Vertex>::getAttributeDescriptions( binding ), maxAttributeOffset<Vertex>() };
+}
+
+// the struct has to be the one of the layout, and getVertexStride has to agree with it
+template< VertexLayout layout, typename Vertex >
+VertexInputDescriptions getLayoutVertexInputDescriptions( const uint32_t binding ){
+	static_assert( VertexTraits<Vertex>::layout == layout, "Vertex struct is not the one of the VertexLayout." );
+	static_assert( getVertexStride( layout ) == VertexInput<Vertex>::stride, "VertexLayout stride does not match the vertex struct." );
+	return getVertexInputDescriptions<Vertex>( binding );
+}
+
+// for a layout known only at runtime (e.g. from a mesh file)
+inline VertexInputDescriptions getVertexInputDescriptions( const VertexLayout layout, const uint32_t binding ){
+	switch( layout ){
+		case VertexLayout::Position2D_ColorF: return getLayoutVertexInputDescriptions<VertexLayout::Position2D_ColorF, Vertex2D_ColorF_pack>( binding );
+		case VertexLayout::Position2D_S16_ColorU8: return getLayoutVertexInputDescriptions<VertexLayout::Position2D_S16_ColorU8, Vertex2D_S16_ColorU8_pack>( binding );
+		default: throw "Unknown vertex layout!";
+	}
+}
+
+#endif //COMMON_VERTEX_INPUT_H
@@ -25,6 +25,7 @@
 #endif
 
 #if  defined(USE_PLATFORM_NONE) \
+  || defined(USE_PLATFORM_HEADLESS) \
   || defined(USE_PLATFORM_GLFW) \
   || defined(VK_USE_PLATFORM_ANDROID_KHR) \
   || defined(VK_USE_PLATFORM_MIR_KHR) \
@@ -15,6 +15,7 @@
 
 #include "CompilerMessages.h"
 #include "ErrorHandling.h"
+#include "Profiler.h"
 
 
 TODO( "Easier to use, but might prevent platform co-existence. Could be namespaced. Make all of this a class?" )
@@ -37,6 +38,9 @@ void setPaintEventHandler( std::function<void(void)> newPaintEventHandler );
 
 void showWindow( PlatformWindow window );
 
+// makes messageLoop() return after the current iteration
+void requestQuit( PlatformWindow window );
+
 
 // Implementation
 //////////////////////////////////
@@ -108,6 +112,10 @@ void showWindow( PlatformWindow window ){
 	if( !hasSwapchain ) hasSwapchain = sizeEventHandler(); 
 }
 
+void requestQuit( PlatformWindow window ){
+	glfwSetWindowShouldClose( window.window, GLFW_TRUE );
+}
+
 std::string getPlatformSurfaceExtensionName(){
 	using std::string;
 
@@ -160,12 +168,27 @@ GLFWmonitor* getCurrentMonitor( GLFWwindow* window ){
 	return bestmonitor;
 }
 
+// size changes are only collected while processing the events, and handled once per loop iteration
+bool sizeChanged = false;
+uint64_t coalescedSizeEvents = 0;
+
 void windowSizeCallback( GLFWwindow*, int, int ) noexcept{
-	hasSwapchain = sizeEventHandler();
+	if( sizeChanged ) ++coalescedSizeEvents;
+	sizeChanged = true;
+}
+
+void handleSizeChange(){
+	if( sizeChanged ){
+		sizeChanged = false;
+		hasSwapchain = sizeEventHandler();
+	}
 }
 
 void windowRefreshCallback( GLFWwindow* ) noexcept{
 	//logger << "refresh" << std::endl;
+
+	// some platforms refresh from inside glfwPollEvents() during live resize, so the size has to be up to date here too
+	handleSizeChange();
 	if( hasSwapchain ) paintEventHandler();
 }
 
@@ -202,12 +225,19 @@ int messageLoop( PlatformWindow window ){
 	using std::to_string;
 
 	while(  errors.empty() && !glfwWindowShouldClose( window.window )  ){
-		if( hasSwapchain ) glfwPollEvents(); // do not block so I can paint
-		else glfwWaitEvents(); // allows blocking if no events
+		{
+			PROFILE_ZONE( "glfwPollEvents" );
+			if( hasSwapchain ) glfwPollEvents(); // do not block so I can paint
+			else glfwWaitEvents(); // allows blocking if no events
+
+			handleSizeChange();
+		}
 
 		if( hasSwapchain ) paintEventHandler(); // repaint always even without OS repaint event
 	}
 
+	logger << "INFO: " << coalescedSizeEvents << " intermediate window size event(s) coalesced." << std::endl;
+
 	if( !errors.empty() ) throw to_string( errors.size() ) + " GLFW error(s) on backlog; 1st error: " + to_string( errors.front().error ) + ": " + errors.front().description;
 
 	return EXIT_SUCCESS;
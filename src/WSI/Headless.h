@@ -0,0 +1,153 @@
+// VK_EXT_headless_surface platform dependent WSI handling and event loop
+//
+// A real VkSurfaceKHR and swapchain, but without any display, so the whole
+// presentation path can be run (and benchmarked) on display-less machines.
+// There is no OS to send events; the message loop renders a fixed number of
+// frames and can simulate window resizes in regular intervals.
+
+#ifndef COMMON_HEADLESS_WSI_H
+#define COMMON_HEADLESS_WSI_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "CompilerMessages.h"
+#include "ErrorHandling.h"
+#include "ExtensionLoader.h"
+
+
+// frames presented to the headless surface before the app quits (HELLO_TRIANGLE_FRAME_COUNT)
+constexpr uint64_t defaultHeadlessFrameCount = 1000;
+
+// a size event is simulated each this many frames, alternating between the initial and half the size; 0 for never (HELLO_TRIANGLE_RESIZE_PERIOD)
+constexpr uint64_t defaultHeadlessResizePeriod = 0;
+
+struct PlatformWindowImpl{
+	uint32_t width, height;
+	uint32_t initialWidth, initialHeight;
+	uint64_t frameCount;
+	uint64_t resizePeriod;
+	bool hasSwapchain = false;
+	bool quit = false;
+};
+
+struct PlatformWindow{
+	std::shared_ptr<PlatformWindowImpl> impl;
+};
+
+std::string getPlatformSurfaceExtensionName(){ return VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME; }
+
+int messageLoop( PlatformWindow window );
+
+bool platformPresentationSupport( VkInstance instance, VkPhysicalDevice device, uint32_t queueFamilyIndex, PlatformWindow window );
+
+PlatformWindow initWindow( const std::string& name, uint32_t canvasWidth, uint32_t canvasHeight );
+void killWindow( PlatformWindow window );
+
+VkSurfaceKHR initSurface( VkInstance instance, PlatformWindow window );
+// killSurface() is not platform dependent
+
+void setSizeEventHandler( std::function<bool(void)> newSizeEventHandler );
+void setPaintEventHandler( std::function<void(void)> newPaintEventHandler );
+
+void showWindow( PlatformWindow window );
+
+// makes messageLoop() return after the current iteration
+void requestQuit( PlatformWindow window );
+
+// headless surface has undefined currentExtent, so the size of the swapchain is taken from here
+uint32_t getWindowWidth( PlatformWindow window ){ return window.impl->width; }
+uint32_t getWindowHeight( PlatformWindow window ){ return window.impl->height; }
+
+
+// Implementation
+//////////////////////////////////
+
+bool nullHandler(){ return false; }
+
+std::function<bool(void)> sizeEventHandler = nullHandler;
+
+void setSizeEventHandler( std::function<bool(void)> newSizeEventHandler ){
+	if( !newSizeEventHandler ) sizeEventHandler = nullHandler;
+	sizeEventHandler = newSizeEventHandler;
+}
+
+std::function<void(void)> paintEventHandler = nullHandler;
+
+void setPaintEventHandler( std::function<void(void)> newPaintEventHandler ){
+	if( !newPaintEventHandler ) paintEventHandler = nullHandler;
+	paintEventHandler = newPaintEventHandler;
+}
+
+void showWindow( PlatformWindow window ){
+	// there is no OS to send the initial size event
+	window.impl->hasSwapchain = sizeEventHandler();
+}
+
+void requestQuit( PlatformWindow window ){
+	window.impl->quit = true;
+}
+
+int messageLoop( PlatformWindow window ){
+	const auto wnd = window.impl;
+	uint64_t simulatedSizeEvents = 0;
+	wnd->quit = false;
+
+	uint64_t frame = 0;
+	for( ; frame < wnd->frameCount && !wnd->quit; ++frame ){
+		if( wnd->resizePeriod && frame > 0 && frame % wnd->resizePeriod == 0 ){
+			const bool initialSize = wnd->width == wnd->initialWidth && wnd->height == wnd->initialHeight;
+			wnd->width = initialSize ? std::max( wnd->initialWidth / 2, 1u ) : wnd->initialWidth;
+			wnd->height = initialSize ? std::max( wnd->initialHeight / 2, 1u ) : wnd->initialHeight;
+
+			++simulatedSizeEvents;
+			wnd->hasSwapchain = sizeEventHandler();
+		}
+
+		if( wnd->hasSwapchain ) paintEventHandler();
+	}
+
+	logger << "INFO: Headless loop ran " << frame << " frame(s) with " << simulatedSizeEvents << " simulated size event(s)." << std::endl;
+
+	return EXIT_SUCCESS;
+}
+
+
+bool platformPresentationSupport( VkInstance, VkPhysicalDevice, uint32_t, PlatformWindow ){
+	return true; // no platform query; vkGetPhysicalDeviceSurfaceSupportKHR decides
+}
+
+PlatformWindow initWindow( const std::string&, const uint32_t canvasWidth, const uint32_t canvasHeight ){
+	auto wnd = std::make_shared<PlatformWindowImpl>();
+
+	wnd->width = wnd->initialWidth = canvasWidth;
+	wnd->height = wnd->initialHeight = canvasHeight;
+	wnd->frameCount = getEnvironmentCount( "HELLO_TRIANGLE_FRAME_COUNT", defaultHeadlessFrameCount );
+	wnd->resizePeriod = getEnvironmentCount( "HELLO_TRIANGLE_RESIZE_PERIOD", defaultHeadlessResizePeriod );
+
+	return { wnd };
+}
+
+void killWindow( PlatformWindow ){}
+
+VkSurfaceKHR initSurface( const VkInstance instance, const PlatformWindow ){
+	const VkHeadlessSurfaceCreateInfoEXT surfaceInfo{
+		VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+		nullptr, // pNext
+		0 // flags - reserved for future use
+	};
+
+	VkSurfaceKHR surface;
+	const VkResult errorCode = vkCreateHeadlessSurfaceEXT( instance, &surfaceInfo, nullptr, &surface ); RESULT_HANDLER( errorCode, "vkCreateHeadlessSurfaceEXT" );
+
+	return surface;
+}
+
+
+#endif //COMMON_HEADLESS_WSI_H
@@ -0,0 +1,92 @@
+// No WSI at all -- offscreen rendering
+//
+// There is no window and no VkSurfaceKHR. The "window" only carries the size of
+// the offscreen render targets, and the message loop just renders frames as fast
+// as it can until the frame limit is reached.
+
+#ifndef COMMON_NONE_WSI_H
+#define COMMON_NONE_WSI_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+#include "CompilerMessages.h"
+#include "ErrorHandling.h"
+
+
+// offscreen frames rendered before the app quits (HELLO_TRIANGLE_FRAME_COUNT)
+constexpr uint64_t defaultOffscreenFrameCount = 1000;
+
+struct PlatformWindow{
+	uint32_t width;
+	uint32_t height;
+	uint64_t frameCount;
+};
+
+int messageLoop( PlatformWindow window );
+
+PlatformWindow initWindow( const std::string& name, uint32_t canvasWidth, uint32_t canvasHeight );
+void killWindow( PlatformWindow window );
+
+// no initSurface() -- there is nothing to present to
+
+void setSizeEventHandler( std::function<bool(void)> newSizeEventHandler );
+void setPaintEventHandler( std::function<void(void)> newPaintEventHandler );
+
+void showWindow( PlatformWindow window );
+
+// makes messageLoop() return after the current iteration
+void requestQuit( PlatformWindow window );
+
+uint32_t getWindowWidth( PlatformWindow window ){ return window.width; }
+uint32_t getWindowHeight( PlatformWindow window ){ return window.height; }
+
+
+// Implementation
+//////////////////////////////////
+
+bool nullHandler(){ return false; }
+
+std::function<bool(void)> sizeEventHandler = nullHandler; // never called; the size never changes
+
+void setSizeEventHandler( std::function<bool(void)> newSizeEventHandler ){
+	if( !newSizeEventHandler ) sizeEventHandler = nullHandler;
+	sizeEventHandler = newSizeEventHandler;
+}
+
+std::function<void(void)> paintEventHandler = nullHandler;
+
+void setPaintEventHandler( std::function<void(void)> newPaintEventHandler ){
+	if( !newPaintEventHandler ) paintEventHandler = nullHandler;
+	paintEventHandler = newPaintEventHandler;
+}
+
+void showWindow( PlatformWindow ){}
+
+bool quitRequested = false;
+
+void requestQuit( PlatformWindow ){
+	quitRequested = true;
+}
+
+int messageLoop( PlatformWindow window ){
+	quitRequested = false;
+
+	uint64_t frame = 0;
+	for( ; frame < window.frameCount && !quitRequested; ++frame ) paintEventHandler();
+
+	logger << "INFO: Rendered " << frame << " offscreen frame(s)." << std::endl;
+
+	return EXIT_SUCCESS;
+}
+
+PlatformWindow initWindow( const std::string&, const uint32_t canvasWidth, const uint32_t canvasHeight ){
+	return { canvasWidth, canvasHeight, getEnvironmentCount( "HELLO_TRIANGLE_FRAME_COUNT", defaultOffscreenFrameCount ) };
+}
+
+void killWindow( PlatformWindow ){}
+
+
+#endif //COMMON_NONE_WSI_H
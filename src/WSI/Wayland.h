@@ -20,6 +20,7 @@
 #include "private/xdg-shell-client-protocol-private.inl"
 #include "CompilerMessages.h"
 #include "ErrorHandling.h"
+#include "Profiler.h"
 
 
 TODO( "Easier to use, but might prevent platform co-existence. Could be namespaced. Make all of this a class?" )
@@ -71,6 +72,9 @@ void setPaintEventHandler( std::function<void(void)> newPaintEventHandler );
 
 void showWindow( PlatformWindow window );
 
+// makes messageLoop() return after the current iteration
+void requestQuit( PlatformWindow window );
+
 uint32_t getWindowWidth( PlatformWindow window ){ return window.impl->width; }
 uint32_t getWindowHeight( PlatformWindow window ){ return window.impl->height; }
 
@@ -370,12 +374,16 @@ void showWindow( PlatformWindow windowh ){
 	paintEventHandler();
 }
 
+void requestQuit( PlatformWindow windowh ){
+	windowh.impl->quit = true;
+}
+
 int messageLoop( PlatformWindow windowh ){
 	auto wnd = windowh.impl;
 	wnd->quit = false;
 
 	while( !wnd->quit ){
-		{const auto dispatched = wl_display_dispatch_pending( wnd->display ); RUNTIME_ASSERT( dispatched != -1, "wl_display_dispatch_pending" );}
+		{PROFILE_ZONE( "wl_display_dispatch_pending" ); const auto dispatched = wl_display_dispatch_pending( wnd->display ); RUNTIME_ASSERT( dispatched != -1, "wl_display_dispatch_pending" );}
 
 		if( wnd->hasSwapchain ){
 			TODO( "Use frame callback instead?" );
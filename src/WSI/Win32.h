@@ -13,6 +13,7 @@
 
 #include "CompilerMessages.h"
 #include "ErrorHandling.h"
+#include "Profiler.h"
 
 
 TODO( "Easier to use, but might prevent platform co-existence. Could be namespaced. Make all of this a class?" )
@@ -38,6 +39,9 @@ void setPaintEventHandler( std::function<void(void)> newPaintEventHandler );
 
 void showWindow( PlatformWindow window );
 
+// makes messageLoop() return after the current iteration
+void requestQuit( PlatformWindow window );
+
 // Implementation
 //////////////////////////////////
 
@@ -62,6 +66,10 @@ void showWindow( PlatformWindow window ){
 	SetForegroundWindow( window.hWnd );
 }
 
+void requestQuit( PlatformWindow ){
+	PostQuitMessage( EXIT_SUCCESS );
+}
+
 bool hasSwapchain = false;
 
 int messageLoop( PlatformWindow window ){
@@ -71,6 +79,7 @@ int messageLoop( PlatformWindow window ){
 	BOOL ret = GetMessageW( &msg, NULL, 0, 0 );
 
 	for( ; ret; ret = GetMessageW( &msg, NULL, 0, 0 ) ){
+			PROFILE_ZONE( "DispatchMessageW" );
 			TranslateMessage( &msg );
 			DispatchMessageW( &msg ); //dispatch to wndProc; ignore return from wndProc
 	}
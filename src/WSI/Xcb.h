@@ -15,6 +15,7 @@
 
 #include "CompilerMessages.h"
 #include "ErrorHandling.h"
+#include "Profiler.h"
 
 
 TODO( "Easier to use, but might prevent platform co-existence. Could be namespaced. Make all of this a class?" )
@@ -37,6 +38,9 @@ void setPaintEventHandler( std::function<void(void)> newPaintEventHandler );
 
 void showWindow( PlatformWindow window );
 
+// makes messageLoop() return after the current iteration
+void requestQuit( PlatformWindow window );
+
 // Implementation
 //////////////////////////////////
 
@@ -61,17 +65,29 @@ void showWindow( PlatformWindow window ){
 	xcb_flush( window.connection );
 }
 
+bool quitRequested = false;
+
+void requestQuit( PlatformWindow ){
+	quitRequested = true;
+}
+
 int messageLoop( PlatformWindow window ){
 	int width = -1;
 	int height = -1;
 	bool hasSwapchain = false;
 
+	// size changes are only collected while draining the event queue, and handled once per loop iteration
+	bool sizeChanged = false;
+	uint64_t coalescedSizeEvents = 0;
+
 	bool quit = false;
+	quitRequested = false;
 
-	while( !quit ){
-		xcb_generic_event_t* e = hasSwapchain ? xcb_poll_for_event( window.connection ) : xcb_wait_for_event( window.connection );
+	while( !quit && !quitRequested ){
+		xcb_generic_event_t* e = (hasSwapchain || sizeChanged) ? xcb_poll_for_event( window.connection ) : xcb_wait_for_event( window.connection );
 
 		if( e ){
+			PROFILE_ZONE( "xcb event dispatch" );
 			switch( e->response_type & ~0x80 ){
 				case XCB_EXPOSE:
 					paintEventHandler();
@@ -83,7 +99,8 @@ int messageLoop( PlatformWindow window ){
 						width = ce->width;
 						height = ce->height;
 
-						hasSwapchain = sizeEventHandler();
+						if( sizeChanged ) ++coalescedSizeEvents;
+						sizeChanged = true;
 					}
 
 					break;
@@ -130,11 +147,18 @@ int messageLoop( PlatformWindow window ){
 
 			free( e );
 		}
-		else if( hasSwapchain ){ // no events pending
-			paintEventHandler();
+		else{ // no events pending
+			if( sizeChanged ){
+				sizeChanged = false;
+				hasSwapchain = sizeEventHandler();
+			}
+
+			if( hasSwapchain ) paintEventHandler();
 		}
 	}
 
+	logger << "INFO: " << coalescedSizeEvents << " intermediate window size event(s) coalesced." << std::endl;
+
 	return 0;
 }
 
@@ -12,6 +12,7 @@
 
 #include "CompilerMessages.h"
 #include "ErrorHandling.h"
+#include "Profiler.h"
 
 
 TODO( "Easier to use, but might prevent platform co-existence. Could be namespaced. Make all of this a class?" )
@@ -32,6 +33,9 @@ void setPaintEventHandler( std::function<void(void)> newPaintEventHandler );
 
 void showWindow( PlatformWindow window );
 
+// makes messageLoop() return after the current iteration
+void requestQuit( PlatformWindow window );
+
 int messageLoop( PlatformWindow window );
 
 // Implementation
@@ -176,14 +180,21 @@ void showWindow( PlatformWindow window ){
 	XUnlockDisplay( window.display );
 }
 
+bool quitRequested = false;
+
+void requestQuit( PlatformWindow ){
+	quitRequested = true;
+}
+
 int messageLoop( PlatformWindow window ){
 	int width = -1;
 	int height = -1;
 	bool hasSwapchain = false;
 
 	bool quit = false;
+	quitRequested = false;
 
-	while( !quit ){
+	while( !quit && !quitRequested ){
 		XEvent e;
 		bool hasEvent = true;
 		const auto always = []( Display*, XEvent*, XPointer ) -> Bool{return true;};
@@ -193,6 +204,7 @@ int messageLoop( PlatformWindow window ){
 		XUnlockDisplay( window.display );
 
 		if( hasEvent ){
+			PROFILE_ZONE( "Xlib event dispatch" );
 			switch( e.type  ){
 				case Expose:
 					paintEventHandler();
@@ -1,7 +1,9 @@
 #ifndef HELLO_TRIANGLE_WSI_PLATFORM_H
 #define HELLO_TRIANGLE_WSI_PLATFORM_H
 
-#if  !defined(USE_PLATFORM_GLFW) \
+#if  !defined(USE_PLATFORM_NONE) \
+  && !defined(USE_PLATFORM_HEADLESS) \
+  && !defined(USE_PLATFORM_GLFW) \
   && !defined(VK_USE_PLATFORM_ANDROID_KHR) \
   && !defined(VK_USE_PLATFORM_WAYLAND_KHR) \
   && !defined(VK_USE_PLATFORM_WIN32_KHR) \
@@ -13,7 +15,11 @@
 	#error "Exactly one Vulkan WSI platform must be defined."
 #endif
 
-#if defined(USE_PLATFORM_GLFW)
+#if defined(USE_PLATFORM_NONE)
+	#include "WSI/None.h"
+#elif defined(USE_PLATFORM_HEADLESS)
+	#include "WSI/Headless.h"
+#elif defined(USE_PLATFORM_GLFW)
 	#include "WSI/Glfw.h"
 #elif defined(VK_USE_PLATFORM_WIN32_KHR)
 	#include "WSI/Win32.h"
@@ -27,10 +33,10 @@
 	#error "Unsupported Vulkan WSI platform, or none selected."
 #endif
 
-#ifndef VK_USE_PLATFORM_WAYLAND_KHR
+#if !defined(VK_USE_PLATFORM_WAYLAND_KHR) && !defined(USE_PLATFORM_NONE) && !defined(USE_PLATFORM_HEADLESS)
 // dummy impl for platforms that do not need these functions
 uint32_t getWindowWidth( PlatformWindow ){ return 0; }
 uint32_t getWindowHeight( PlatformWindow ){ return 0; }
 #endif
 
-#endif //HELLO_TRIANGLE_WSI_PLATFORM_H
\ No newline at end of file
+#endif //HELLO_TRIANGLE_WSI_PLATFORM_H
\ No newline at end of file
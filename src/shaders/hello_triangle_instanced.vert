@@ -0,0 +1,16 @@
+#version 450
+
+layout (location = 0) in vec2 inPos;
+layout (location = 1) in vec3 inColor;
+
+// per instance
+layout (location = 2) in vec2 inInstanceOffset;
+layout (location = 3) in float inInstanceScale;
+layout (location = 4) in vec4 inInstanceColor;
+
+layout (location = 0) smooth out vec3 outColor;
+
+void main(){
+	outColor = inColor * inInstanceColor.rgb;
+	gl_Position = vec4( inPos.xy * inInstanceScale + inInstanceOffset, 0.0, 1.0 );
+}